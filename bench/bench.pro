@@ -0,0 +1,40 @@
+TEMPLATE = app
+TARGET = bench
+QT += core network sql testlib
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+SOURCES += src/main.cpp \
+           src/protocolbench.cpp \
+           ../server/src/roomhub.cpp \
+           ../server/src/egressqueue.cpp \
+           ../server/src/databasemanager.cpp \
+           ../server/src/usercache.cpp \
+           ../server/src/sessionstore.cpp \
+           ../server/src/logging.cpp \
+           ../server/src/transport.cpp \
+           ../server/src/qttransport.cpp \
+           ../server/src/dbworker.cpp \
+           ../server/src/recorder.cpp \
+           ../server/src/recording.cpp \
+           ../server/src/replaysource.cpp \
+           ../server/src/timeseries.cpp
+HEADERS += src/protocolbench.h \
+           ../server/src/roomhub.h \
+           ../server/src/databasemanager.h \
+           ../server/src/usercache.h \
+           ../server/src/sessionstore.h \
+           ../server/src/logging.h \
+           ../server/src/transport.h \
+           ../server/src/qttransport.h \
+           ../server/src/dbworker.h \
+           ../server/src/recorder.h \
+           ../server/src/recording.h \
+           ../server/src/replaysource.h \
+           ../server/src/timeseries.h \
+           ../server/src/spscqueue.h
+linux {
+    SOURCES += ../server/src/epolltransport.cpp
+    HEADERS += ../server/src/epolltransport.h
+}
+include(../common/common.pri)
@@ -0,0 +1,8 @@
+#!/usr/bin/env bash
+# 运行基准并输出机器可读结果（QtTest XML），同时在终端打印文本结果
+# 用法：./run_bench.sh [QtTest参数]，例如 ./run_bench.sh drainBurst
+set -e
+cd "$(dirname "$0")"
+qmake
+make -j
+./bench -o bench_results.xml,xml -o -,txt "$@"
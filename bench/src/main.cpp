@@ -0,0 +1,4 @@
+#include <QtTest>
+#include "protocolbench.h"
+
+QTEST_GUILESS_MAIN(ProtocolBench)
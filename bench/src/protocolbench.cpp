@@ -0,0 +1,782 @@
+#include "protocolbench.h"
+#include "../../common/protocol.h"
+#include "../../server/src/roomhub.h"
+#include "../../server/src/qttransport.h"
+#include "../../server/src/databasemanager.h"
+#include "../../server/src/recording.h"
+#include "../../server/src/timeseries.h"
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
+// ---- 测试数据 ----
+
+// 构造一条总长恰为 frameSize 字节的设备数据帧（JSON + 填充bin）
+static QByteArray makeFrame(int frameSize)
+{
+    const QJsonObject j{{"roomId", "R123"}, {"ts", 1700000000000.0}};
+    const int fixed = buildPacket(MSG_AUDIO_FRAME, j).size();
+    return buildPacket(MSG_AUDIO_FRAME, j, QByteArray(qMax(0, frameSize - fixed), 'x'));
+}
+
+static QByteArray makeBurst(int totalBytes, int frameSize)
+{
+    const QByteArray frame = makeFrame(frameSize);
+    QByteArray burst;
+    burst.reserve(totalBytes + frame.size());
+    while (burst.size() + frame.size() <= totalBytes)
+        burst.append(frame);
+    return burst;
+}
+
+static QList<QByteArray> splitChunks(const QByteArray& data, int chunkSize)
+{
+    QList<QByteArray> chunks;
+    for (int i = 0; i < data.size(); i += chunkSize)
+        chunks.append(data.mid(i, chunkSize));
+    return chunks;
+}
+
+// 各消息类型的典型消息体
+static QJsonObject sampleBody(const QString& kind)
+{
+    if (kind == "text")
+        return QJsonObject{{"roomId", "R123"}, {"sender", "factory-A"},
+                           {"content", "主轴温度偏高，请确认冷却液"}, {"ts", 1700000000123.0}};
+    if (kind == "device")
+        return QJsonObject{{"roomId", "R123"}, {"deviceId", "CNC-07"}, {"type", "spindle_temp"},
+                           {"value", 71.234567}, {"unit", "C"}, {"ts", 1700000000123.0}};
+    if (kind == "control")
+        return QJsonObject{{"roomId", "R123"}, {"command", "stop"}, {"target", "CNC-07"},
+                           {"ts", 1700000000123.0}};
+    return QJsonObject{{"roomId", "R123"}, {"username", "expert-B"}, {"user_type", 2}};
+}
+
+// ---- 旧实现（left() + remove() + QDataStream），用于对比 ----
+
+// 改为 framePacket/qToBigEndian 之前的 buildPacket：QDataStream 写头部 + 连续拷贝
+static QByteArray legacyBuildPacket(quint16 type, const QJsonObject& json, const QByteArray& bin)
+{
+    QByteArray jsonBytes = toJsonBytes(json);
+    quint32 jsonSize = static_cast<quint32>(jsonBytes.size());
+    quint32 length = static_cast<quint32>(2 + 4 + jsonSize + bin.size());
+
+    QByteArray out;
+    out.reserve(4 + length);
+
+    QDataStream ds(&out, QIODevice::WriteOnly);
+    ds.setByteOrder(QDataStream::BigEndian);
+
+    ds << length;
+    ds << type;
+    ds << jsonSize;
+    if (!jsonBytes.isEmpty())
+        ds.writeRawData(jsonBytes.constData(), jsonBytes.size());
+    if (!bin.isEmpty())
+        ds.writeRawData(bin.constData(), bin.size());
+
+    return out;
+}
+
+struct LegacyPacket {
+    quint16 type = 0;
+    QJsonObject json;
+    QByteArray bin;
+};
+
+static bool legacyDrainPackets(QByteArray& buffer, QVector<LegacyPacket>& out)
+{
+    bool produced = false;
+    for (;;) {
+        if (buffer.size() < 4) break;
+        quint32 length = 0;
+        {
+            QDataStream peek(buffer.left(4));
+            peek.setByteOrder(QDataStream::BigEndian);
+            peek >> length;
+        }
+        if (length < 6) { buffer.clear(); break; }
+        const int totalNeed = 4 + int(length);
+        if (buffer.size() < totalNeed) break;
+
+        QByteArray block = buffer.left(totalNeed);
+        buffer.remove(0, totalNeed);
+
+        QDataStream ds(block);
+        ds.setByteOrder(QDataStream::BigEndian);
+        quint32 lenField = 0; ds >> lenField;
+        quint16 type = 0;     ds >> type;
+        quint32 jsonSize = 0; ds >> jsonSize;
+        const int payloadBytes = totalNeed - 10;
+        if (jsonSize > (quint32)payloadBytes) continue;
+
+        QByteArray jsonBytes(jsonSize, Qt::Uninitialized);
+        if (jsonSize > 0) ds.readRawData(jsonBytes.data(), jsonBytes.size());
+        LegacyPacket pkt;
+        pkt.type = type;
+        pkt.json = fromJsonBytes(jsonBytes);
+        const int binSize = payloadBytes - int(jsonSize);
+        if (binSize > 0) pkt.bin = block.right(binSize);
+        out.push_back(pkt);
+        produced = true;
+    }
+    return produced;
+}
+
+// 旧的数据库实现：默认日志模式、无索引、每次调用重新 prepare，注册前单独查询用户是否存在
+static const char* const kLegacyDb = "bench_legacy";
+static const int kDbUsers = 1000;
+
+static bool legacyUserExists(QSqlDatabase db, const QString& username)
+{
+    if (!db.open()) return false;
+    QSqlQuery query(db);
+    query.prepare("SELECT id FROM users WHERE username = :username");
+    query.bindValue(":username", username);
+    return query.exec() && query.next();
+}
+
+static bool legacyAddUser(const QString& username, const QString& password, int userType)
+{
+    QSqlDatabase db = QSqlDatabase::database(kLegacyDb);
+    if (!db.open() || legacyUserExists(db, username)) return false;
+    const QString hash = QCryptographicHash::hash(password.toUtf8(), QCryptographicHash::Sha256).toHex();
+    QSqlQuery query(db);
+    query.prepare(R"(INSERT INTO users (username,password_hash,email,phone,user_type)
+                     VALUES(:username,:password_hash,:email,:phone,:user_type))");
+    query.bindValue(":username", username);
+    query.bindValue(":password_hash", hash);
+    query.bindValue(":email", QString());
+    query.bindValue(":phone", QString());
+    query.bindValue(":user_type", userType);
+    return query.exec();
+}
+
+static bool legacyValidateUser(const QString& username, const QString& password, int userType)
+{
+    QSqlDatabase db = QSqlDatabase::database(kLegacyDb);
+    QSqlQuery query(db);
+    query.prepare("SELECT password_hash FROM users WHERE username = :username AND user_type = :user_type");
+    query.bindValue(":username", username);
+    query.bindValue(":user_type", userType);
+    if (!query.exec() || !query.next()) return false;
+    const QString hash = QCryptographicHash::hash(password.toUtf8(), QCryptographicHash::Sha256).toHex();
+    return query.value(0).toString() == hash;
+}
+
+// ---- 打包 ----
+
+void ProtocolBench::buildPacket_data()
+{
+    QTest::addColumn<bool>("legacy");
+    QTest::addColumn<int>("binSize");
+    QTest::newRow("legacy/json-only") << true << 0;
+    QTest::newRow("legacy/audio-640B") << true << 640;
+    QTest::newRow("legacy/video-200KB") << true << 200 * 1024;
+    QTest::newRow("json-only") << false << 0;
+    QTest::newRow("audio-640B") << false << 640;
+    QTest::newRow("video-200KB") << false << 200 * 1024;
+}
+
+void ProtocolBench::buildPacket()
+{
+    QFETCH(bool, legacy);
+    QFETCH(int, binSize);
+    const QJsonObject j = sampleBody("control");
+    const QByteArray bin(binSize, 'j');
+    QCOMPARE(legacyBuildPacket(MSG_VIDEO_FRAME, j, bin), ::buildPacket(MSG_VIDEO_FRAME, j, bin));
+    QBENCHMARK {
+        QByteArray pkt = legacy ? legacyBuildPacket(MSG_VIDEO_FRAME, j, bin)
+                                : ::buildPacket(MSG_VIDEO_FRAME, j, bin);
+        Q_UNUSED(pkt);
+    }
+}
+
+void ProtocolBench::framePacket_data()
+{
+    QTest::addColumn<int>("binSize");
+    QTest::newRow("json-only") << 0;
+    QTest::newRow("audio-640B") << 640;
+    QTest::newRow("video-200KB") << 200 * 1024;
+}
+
+void ProtocolBench::framePacket()
+{
+    QFETCH(int, binSize);
+    const QJsonObject j = sampleBody("control");
+    const QByteArray bin(binSize, 'j');
+    QBENCHMARK {
+        FramedPacket f = ::framePacket(MSG_VIDEO_FRAME, j, bin);
+        Q_UNUSED(f);
+    }
+}
+
+void ProtocolBench::writeFrame_data()
+{
+    QTest::addColumn<bool>("flatten");
+    QTest::addColumn<int>("binSize");
+    QTest::newRow("flatten-write/audio-640B") << true << 640;
+    QTest::newRow("flatten-write/video-200KB") << true << 200 * 1024;
+    QTest::newRow("writeSegments/audio-640B") << false << 640;
+    QTest::newRow("writeSegments/video-200KB") << false << 200 * 1024;
+}
+
+// 每轮：打包并写出一帧到环回连接，对端读完为止（两种写法的读取开销相同）
+void ProtocolBench::writeFrame()
+{
+    QFETCH(bool, flatten);
+    QFETCH(int, binSize);
+    QVERIFY(listener_.isListening() || listener_.listen(QHostAddress::LocalHost, 0));
+    QTcpSocket sender;
+    sender.connectToHost(QHostAddress::LocalHost, listener_.serverPort());
+    QVERIFY(sender.waitForConnected(3000));
+    QVERIFY(listener_.hasPendingConnections() || listener_.waitForNewConnection(3000));
+    QScopedPointer<QTcpSocket> receiver(listener_.nextPendingConnection());
+    QVERIFY(receiver);
+
+    const QJsonObject j = sampleBody("control");
+    const QByteArray bin(binSize, 'j');
+    QBENCHMARK {
+        const FramedPacket f = ::framePacket(MSG_VIDEO_FRAME, j, bin);
+        const qint64 written = flatten ? sender.write(f.flatten()) : writeFramed(&sender, f);
+        QCOMPARE(written, qint64(f.size()));
+        qint64 got = 0;
+        while (got < f.size()) {
+            if (sender.bytesToWrite() > 0)
+                sender.waitForBytesWritten(10);
+            if (receiver->bytesAvailable() == 0)
+                receiver->waitForReadyRead(10);
+            got += receiver->readAll().size();
+        }
+    }
+}
+
+// ---- 拆包 ----
+
+void ProtocolBench::drainBurst_data()
+{
+    QTest::addColumn<bool>("legacy");
+    QTest::addColumn<int>("totalBytes");
+    QTest::addColumn<int>("chunkSize");
+
+    const int mb = 1024 * 1024;
+    QTest::newRow("legacy/whole-1MB-200B") << true << mb << mb;
+    QTest::newRow("buffer/whole-1MB-200B") << false << mb << mb;
+    QTest::newRow("legacy/split-1460-1MB") << true << mb << 1460;
+    QTest::newRow("buffer/split-1460-1MB") << false << mb << 1460;
+    QTest::newRow("legacy/trickle-1B-64KB") << true << 64 * 1024 << 1;
+    QTest::newRow("buffer/trickle-1B-64KB") << false << 64 * 1024 << 1;
+}
+
+void ProtocolBench::drainBurst()
+{
+    QFETCH(bool, legacy);
+    QFETCH(int, totalBytes);
+    QFETCH(int, chunkSize);
+
+    const QByteArray burst = makeBurst(totalBytes, 200);
+    const QList<QByteArray> chunks = splitChunks(burst, chunkSize);
+    const int expected = burst.size() / 200;
+
+    int produced = 0;
+    if (legacy) {
+        QBENCHMARK {
+            QByteArray buf;
+            QVector<LegacyPacket> out;
+            for (const QByteArray& c : chunks) {
+                buf.append(c);
+                legacyDrainPackets(buf, out);
+            }
+            produced = out.size();
+        }
+    } else {
+        QBENCHMARK {
+            PacketBuffer buf;
+            QVector<Packet> out;
+            for (const QByteArray& c : chunks) {
+                buf.append(c);
+                buf.drain(out);
+            }
+            produced = out.size();
+        }
+    }
+    QCOMPARE(produced, expected);
+}
+
+// ---- 消息体编解码 ----
+
+static void bodyRows()
+{
+    QTest::addColumn<QString>("kind");
+    QTest::addColumn<int>("encoding");
+    const QStringList kinds{"text", "device", "control", "join"};
+    for (const QString& k : kinds) {
+        QTest::newRow(qPrintable("json/" + k)) << k << int(BODY_JSON);
+        QTest::newRow(qPrintable("cbor/" + k)) << k << int(BODY_CBOR);
+    }
+}
+
+void ProtocolBench::encodeBody_data()
+{
+    bodyRows();
+}
+
+void ProtocolBench::encodeBody()
+{
+    QFETCH(QString, kind);
+    QFETCH(int, encoding);
+    const QJsonObject j = sampleBody(kind);
+    QBENCHMARK {
+        QByteArray body = ::encodeBody(j, BodyEncoding(encoding));
+        Q_UNUSED(body);
+    }
+}
+
+void ProtocolBench::decodeBody_data()
+{
+    bodyRows();
+}
+
+void ProtocolBench::decodeBody()
+{
+    QFETCH(QString, kind);
+    QFETCH(int, encoding);
+    const QByteArray body = ::encodeBody(sampleBody(kind), BodyEncoding(encoding));
+    QBENCHMARK {
+        QJsonObject j = ::decodeBody(body, BodyEncoding(encoding));
+        Q_UNUSED(j);
+    }
+}
+
+// 线上字节数对比（以 info 消息写入结果文件）
+void ProtocolBench::bodyWireSize()
+{
+    const QStringList kinds{"text", "device", "control", "join"};
+    for (const QString& k : kinds) {
+        const QJsonObject j = sampleBody(k);
+        qInfo().noquote() << QString("wire-size %1 json=%2 cbor=%3")
+                             .arg(k)
+                             .arg(::encodeBody(j, BODY_JSON).size())
+                             .arg(::encodeBody(j, BODY_CBOR).size());
+    }
+}
+
+// ---- 字段读取 ----
+
+void ProtocolBench::readField_data()
+{
+    QTest::addColumn<int>("encoding");
+    QTest::addColumn<bool>("scan");
+    QTest::newRow("json/dom") << int(BODY_JSON) << false;
+    QTest::newRow("json/scan") << int(BODY_JSON) << true;
+    QTest::newRow("cbor/dom") << int(BODY_CBOR) << false;
+    QTest::newRow("cbor/scan") << int(BODY_CBOR) << true;
+}
+
+void ProtocolBench::readField()
+{
+    QFETCH(int, encoding);
+    QFETCH(bool, scan);
+    const QByteArray frame = ::buildPacket(MSG_CONTROL, sampleBody("control"), QByteArray(),
+                                           BodyEncoding(encoding));
+    QVector<Packet> pkts;
+    QByteArray buf = frame;
+    QVERIFY(drainPackets(buf, pkts));
+
+    QString target;
+    QBENCHMARK {
+        Packet p = pkts.first(); // 每轮都是未解码的新副本
+        target = scan ? p.target() : p.json().value("target").toString();
+    }
+    QCOMPARE(target, QString("CNC-07"));
+}
+
+// ---- 房间转发 ----
+
+void ProtocolBench::connectPeer(RoomHub& hub)
+{
+    QVERIFY(listener_.isListening() || listener_.listen(QHostAddress::LocalHost, 0));
+    auto* peer = new QTcpSocket;
+    peer->connectToHost(QHostAddress::LocalHost, listener_.serverPort());
+    QVERIFY(peer->waitForConnected(3000));
+    QVERIFY(listener_.hasPendingConnections() || listener_.waitForNewConnection(3000));
+    QTcpSocket* member = listener_.nextPendingConnection();
+    QVERIFY(member);
+    peers_.append(peer);
+#ifdef Q_OS_UNIX
+    // 关闭时直接RST，不留 TIME_WAIT（连接抖动用例会建立大量连接）
+    const struct linger lg = { 1, 0 };
+    ::setsockopt(int(peer->socketDescriptor()), SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+#endif
+
+    // 服务端一侧交给 hub 的传输层
+    if (hub.transportName() == "qt") {
+        hub.adoptConnection(new QtConnection(member));
+    } else {
+#ifdef Q_OS_UNIX
+        const qintptr fd = ::dup(int(member->socketDescriptor()));
+        delete member;
+        hub.adoptDescriptor(fd);
+#endif
+    }
+}
+
+void ProtocolBench::setupRoom(RoomHub& hub, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        connectPeer(hub);
+        if (QTest::currentTestFailed()) return;
+    }
+    QCOMPARE(hub.clientCount(), n);
+    hub.admitAll("BENCH");
+}
+
+// 接收方读走数据，避免发送缓冲无限增长
+void ProtocolBench::drainPeers()
+{
+    QCoreApplication::processEvents();
+    for (QTcpSocket* p : peers_)
+        p->readAll();
+}
+
+void ProtocolBench::broadcastToRoom_data()
+{
+    QTest::addColumn<QString>("transport");
+    QTest::addColumn<int>("receivers");
+    QTest::addColumn<int>("frameSize");
+    QStringList transports{"qt"};
+#ifdef Q_OS_LINUX
+    transports << "epoll";
+#endif
+    for (const QString& t : transports) {
+        const QByteArray prefix = t.toLatin1() + "/";
+        QTest::newRow((prefix + "2-rx/audio-640B").constData()) << t << 2 << 640;
+        QTest::newRow((prefix + "10-rx/audio-640B").constData()) << t << 10 << 640;
+        QTest::newRow((prefix + "100-rx/audio-640B").constData()) << t << 100 << 640;
+        QTest::newRow((prefix + "2-rx/video-20KB").constData()) << t << 2 << 20 * 1024;
+        QTest::newRow((prefix + "10-rx/video-20KB").constData()) << t << 10 << 20 * 1024;
+        QTest::newRow((prefix + "100-rx/video-20KB").constData()) << t << 100 << 20 * 1024;
+    }
+}
+
+// 每轮：广播一帧 + 接收方读走（读取开销计入结果，接收方数量相同的行之间可直接比较）
+void ProtocolBench::broadcastToRoom()
+{
+    QFETCH(QString, transport);
+    QFETCH(int, receivers);
+    QFETCH(int, frameSize);
+
+    RoomHub hub(transport);
+    setupRoom(hub, receivers);
+    if (QTest::currentTestFailed()) return;
+    const QByteArray frame = makeFrame(frameSize);
+    const int room = hub.roomHandle("BENCH");
+
+    QBENCHMARK {
+        hub.broadcastToRoom(room, frame);
+        drainPeers();
+    }
+
+    hub.dropAllClients();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+// 正确性：发送方的分片流在中途作废（这里是跳过一个分片）时，已收到前面分片的接收方收到中止帧，
+// 不会一直占着重组状态等待永远不来的后续分片
+void ProtocolBench::relayTruncated()
+{
+    RoomHub hub("qt");
+    connectPeer(hub);
+    connectPeer(hub);
+    if (QTest::currentTestFailed()) return;
+    hub.admitAll("RELAY", true);
+    QTcpSocket* sender = peers_.at(0);
+    QTcpSocket* receiver = peers_.at(1);
+
+    const QByteArray bin(8 * kFragmentSize, 'v');
+    const QVector<FramedPacket> frags = fragmentPacket(MSG_VIDEO_FRAME, encodeBody(sampleBody("control"), BODY_JSON),
+                                                       bin, 7, BODY_JSON);
+    QVERIFY(frags.size() == 8);
+    sender->write(frags.at(0).flatten());
+    sender->write(frags.at(1).flatten());
+    sender->write(frags.at(3).flatten()); // 缺少第3片：服务器重组作废该流
+    QVERIFY(sender->waitForBytesWritten(3000));
+
+    PacketBuffer rx;
+    rx.setDeliverFragments(true);
+    QVector<Packet> got;
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < 3000 && (got.isEmpty() || !got.last().fragmentAbort())) {
+        QTest::qWait(10);
+        rx.append(receiver->readAll());
+        rx.drain(got);
+    }
+    QCOMPARE(got.size(), 3);
+    QCOMPARE(got.at(0).fragmentOffset, 0u);
+    QCOMPARE(got.at(1).fragmentOffset, quint32(kFragmentSize));
+    QVERIFY(got.at(2).fragmentAbort());
+    QCOMPARE(got.at(2).streamId, got.at(0).streamId);
+    for (const Packet& p : got)
+        QVERIFY(!p.reassembled);
+
+    hub.dropAllClients();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+void ProtocolBench::connectionChurn_data()
+{
+    QTest::addColumn<QString>("transport");
+    QTest::addColumn<int>("batch");
+    QStringList transports{"qt"};
+#ifdef Q_OS_LINUX
+    transports << "epoll";
+#endif
+    for (const QString& t : transports) {
+        const QByteArray prefix = t.toLatin1() + "/";
+        QTest::newRow((prefix + "10-conn").constData()) << t << 10;
+        QTest::newRow((prefix + "100-conn").constData()) << t << 100;
+    }
+}
+
+// 每轮：batch 个客户端接入并加入同一房间，然后全部断开
+// 计入环回 connect/accept 的开销（各版本相同），差异来自连接记录的分配、挂载与清理
+void ProtocolBench::connectionChurn()
+{
+    QFETCH(QString, transport);
+    QFETCH(int, batch);
+
+    RoomHub hub(transport);
+    QBENCHMARK {
+        for (int i = 0; i < batch; ++i) {
+            connectPeer(hub);
+            if (QTest::currentTestFailed()) return;
+        }
+        hub.admitAll("CHURN");
+        qDeleteAll(peers_);
+        peers_.clear();
+        hub.dropAllClients();
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    }
+    QCOMPARE(hub.roomCount(), 0);
+}
+
+// ---- 数据库 ----
+
+void ProtocolBench::setupDatabases()
+{
+    if (dbReady_) return;
+    QVERIFY(dbDir_.isValid());
+
+    QSqlDatabase legacy = QSqlDatabase::addDatabase("QSQLITE", kLegacyDb);
+    legacy.setDatabaseName(dbDir_.filePath("legacy.db"));
+    QVERIFY(legacy.open());
+    QSqlQuery create(legacy);
+    QVERIFY(create.exec(R"(CREATE TABLE users (
+                           id INTEGER PRIMARY KEY AUTOINCREMENT,
+                           username TEXT UNIQUE NOT NULL,
+                           password_hash TEXT NOT NULL,
+                           email TEXT,
+                           phone TEXT,
+                           user_type INTEGER NOT NULL,
+                           created_at DATETIME DEFAULT CURRENT_TIMESTAMP))"));
+
+    DatabaseManager& db = DatabaseManager::instance();
+    db.setDatabasePath(dbDir_.filePath("tuned.db"));
+    QVERIFY(db.initialize());
+
+    for (int i = 0; i < kDbUsers; ++i) {
+        const QString name = QString("user-%1").arg(i);
+        QVERIFY(legacyAddUser(name, "secret", 1 + i % 2));
+        QVERIFY(db.addUser(name, "secret", QString(), QString(), 1 + i % 2));
+    }
+    dbReady_ = true;
+}
+
+void ProtocolBench::dbLogin_data()
+{
+    QTest::addColumn<bool>("legacy");
+    QTest::addColumn<bool>("cached");
+    QTest::newRow("legacy") << true << false;
+    QTest::newRow("tuned") << false << false;
+    QTest::newRow("tuned+cache") << false << true; // 同一批用户反复重连：全部命中用户记录缓存
+}
+
+void ProtocolBench::dbLogin()
+{
+    QFETCH(bool, legacy);
+    QFETCH(bool, cached);
+    setupDatabases();
+    if (QTest::currentTestFailed()) return;
+
+    DatabaseManager& db = DatabaseManager::instance();
+    db.userCache().clear();
+    db.userCache().setCapacity(cached ? kDbUsers : 0);
+    if (cached)
+        QCOMPARE(db.warmUpCache(kDbUsers), kDbUsers);
+    int i = 0;
+    bool ok = true;
+    QBENCHMARK {
+        const QString name = QString("user-%1").arg(i % kDbUsers);
+        const int userType = 1 + i % 2;
+        ok = ok && (legacy ? legacyValidateUser(name, "secret", userType)
+                           : db.validateUser(name, "secret", userType));
+        ++i;
+    }
+    QVERIFY(ok);
+}
+
+void ProtocolBench::dbRegister_data()
+{
+    QTest::addColumn<bool>("legacy");
+    QTest::newRow("legacy") << true;
+    QTest::newRow("tuned") << false;
+}
+
+void ProtocolBench::dbRegister()
+{
+    QFETCH(bool, legacy);
+    setupDatabases();
+    if (QTest::currentTestFailed()) return;
+
+    DatabaseManager& db = DatabaseManager::instance();
+    static int serial = 0; // 跨轮次/行保持唯一用户名
+    bool ok = true;
+    QBENCHMARK {
+        const QString name = QString("reg-%1").arg(serial++);
+        ok = ok && (legacy ? legacyAddUser(name, "secret", 1)
+                           : db.addUser(name, "secret", QString(), QString(), 1));
+    }
+    QVERIFY(ok);
+}
+
+void ProtocolBench::recordingAppend_data()
+{
+    QTest::addColumn<int>("videoKB");
+    QTest::newRow("30fps-20KB") << 20;
+    QTest::newRow("30fps-60KB") << 60;
+}
+
+void ProtocolBench::recordingAppend()
+{
+    QFETCH(int, videoKB);
+    QVERIFY(recDir_.isValid());
+    const QByteArray video = buildPacket(MSG_VIDEO_FRAME, QJsonObject{{"seq", 1}}, QByteArray(videoKB * 1024, 'v'));
+    const QByteArray audio = buildPacket(MSG_AUDIO_FRAME, QJsonObject{{"seq", 1}}, QByteArray(640, 'a'));
+    const QByteArray device = buildPacket(MSG_DEVICE_DATA,
+                                          QJsonObject{{"deviceId", "d1"}, {"type", "temp"}, {"value", 21.5}});
+
+    SegmentWriter writer(recDir_.filePath(QString("append-%1").arg(videoKB)));
+    qint64 ms = QDateTime::currentMSecsSinceEpoch();
+    bool ok = true;
+    QBENCHMARK {
+        for (int i = 0; i < 50; ++i) {               // 20ms 音频
+            ok = ok && writer.append(ms + i * 20, audio);
+            if (i % 5 == 0) ok = ok && writer.append(ms + i * 20, device);
+            if (i % 5 < 3) ok = ok && writer.append(ms + i * 20, video); // 约30fps
+        }
+        ms += 1000;
+        ok = ok && writer.flush() && writer.sync();
+    }
+    QVERIFY(ok);
+}
+
+void ProtocolBench::recordingSeek()
+{
+    QVERIFY(recDir_.isValid());
+    const QString dir = recDir_.filePath("seek");
+    const QByteArray device = buildPacket(MSG_DEVICE_DATA,
+                                          QJsonObject{{"deviceId", "d1"}, {"type", "temp"}, {"value", 21.5}});
+    const int records = 100000;
+    const qint64 first = QDateTime::currentMSecsSinceEpoch();
+    {
+        SegmentWriter writer(dir);
+        for (int i = 0; i < records; ++i)
+            QVERIFY(writer.append(first + i * 33, device));
+    }
+
+    RecordingReader reader;
+    QVERIFY2(reader.open(dir), qPrintable(reader.errorString()));
+    QCOMPARE(reader.recordCount(), quint64(records));
+    int i = 0;
+    qint64 ms = 0;
+    QBENCHMARK {
+        const int k = (i++ * 7919) % records;
+        RecordingReader::Cursor c = reader.seek(first + qint64(k) * 33);
+        QVERIFY(reader.next(c, &ms, nullptr));
+    }
+    QVERIFY(ms >= first);
+}
+
+void ProtocolBench::deviceIngest()
+{
+    TimeSeriesStore& store = TimeSeriesStore::instance();
+    static const char* kMetrics[] = {"spindle_temp", "vibration", "current", "pressure"};
+    qint64 ms = 1700000000000LL;
+    bool ok = true;
+    QBENCHMARK {
+        for (int i = 0; i < 10000; ++i) {
+            const int series = i % 100;
+            ok = ok && store.append("bench-ingest", QString("CNC-%1").arg(series / 4), kMetrics[series % 4],
+                                    ms + i, 60.0 + (i % 50) * 0.25);
+        }
+        ms += 10000;
+    }
+    QVERIFY(ok);
+}
+
+void ProtocolBench::deviceQuery_data()
+{
+    QTest::addColumn<QString>("kind");
+    QTest::newRow("raw-1h") << "raw";
+    QTest::newRow("minute-week") << "minute";
+    QTest::newRow("aggregate-6h") << "aggregate";
+    QTest::newRow("chart-6h") << "chart-6h";     // MSG_DEVICE_QUERY：2.16万个原始点 LTTB 到1000点（1分钟汇总只有361桶）
+    QTest::newRow("chart-week") << "chart-week"; // MSG_DEVICE_QUERY：1分钟汇总合并到1000桶以内
+}
+
+void ProtocolBench::deviceQuery()
+{
+    QFETCH(QString, kind);
+    // 一周的 1Hz 数据（同一序列只写一次，多行共用）；原始数据按默认保留期只留最近6小时
+    TimeSeriesStore& store = TimeSeriesStore::instance();
+    static const qint64 kWeekMs = 7LL * 24 * 3600 * 1000;
+    static const qint64 start = 1700000000000LL;
+    static bool filled = false;
+    if (!filled) {
+        for (qint64 t = 0; t < kWeekMs; t += 1000)
+            store.append("bench-query", "CNC-1", "spindle_temp", start + t, 60.0 + (t / 1000 % 600) * 0.05);
+        filled = true;
+    }
+    const qint64 end = start + kWeekMs;
+
+    int n = 0;
+    QBENCHMARK {
+        if (kind == "raw") {
+            n = store.raw("bench-query", "CNC-1", "spindle_temp", end - 3600 * 1000, end).size();
+        } else if (kind == "minute") {
+            n = store.rollup("bench-query", "CNC-1", "spindle_temp", TimeSeriesStore::Minute,
+                             start, end).size();
+        } else if (kind == "aggregate") {
+            n = int(store.aggregate("bench-query", "CNC-1", "spindle_temp", end - 6 * 3600 * 1000, end).count);
+        } else {
+            const qint64 from = kind == "chart-6h" ? end - 6 * 3600 * 1000 : start;
+            const TsQueryResult r = store.query("bench-query", "CNC-1", "spindle_temp", from, end, 1000);
+            n = r.points.size() + r.buckets.size();
+        }
+    }
+    QVERIFY(n > 0);
+}
+
+void ProtocolBench::initTestCase()
+{
+    // 每个连接的接入/断开日志会淹没基准输出
+    QLoggingCategory::setFilterRules(QStringLiteral("hub.*.info=false"));
+}
+
+void ProtocolBench::cleanup()
+{
+    qDeleteAll(peers_);
+    peers_.clear();
+}
@@ -0,0 +1,87 @@
+#pragma once
+// ===============================================
+// bench/src/protocolbench.h
+// 协议编解码与房间转发基准（QBENCHMARK）
+// 运行：./run_bench.sh，结果写入 bench_results.xml（QtTest XML，便于跟踪回归）
+// ===============================================
+#include <QtCore>
+#include <QtNetwork>
+#include <QtTest>
+
+class RoomHub;
+
+class ProtocolBench : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+
+    // 打包：连续 buildPacket（对比旧的 QDataStream 实现）与分段 framePacket
+    void buildPacket_data();
+    void buildPacket();
+    void framePacket_data();
+    void framePacket();
+    // 写出：writeSegments（iovec）与拼接后 write
+    void writeFrame_data();
+    void writeFrame();
+
+    // 拆包：整包 / 按MTU拆分 / 1字节涓流，对比旧的 left()+remove() 实现
+    void drainBurst_data();
+    void drainBurst();
+
+    // 消息体编解码：JSON 与 CBOR
+    void encodeBody_data();
+    void encodeBody();
+    void decodeBody_data();
+    void decodeBody();
+    void bodyWireSize();
+
+    // 字段读取：扫描器与完整解码
+    void readField_data();
+    void readField();
+
+    // 房间转发：qt/epoll 传输层 × 2/10/100 个进程内接收方
+    void broadcastToRoom_data();
+    void broadcastToRoom();
+
+    // 正确性：直通转发的分片流中途作废时接收方收到中止帧
+    void relayTruncated();
+
+    // 连接抖动（交接班时批量重连）：接入 + 加入房间 + 断开，qt/epoll × 每轮连接数
+    void connectionChurn_data();
+    void connectionChurn();
+
+    // 数据库：每轮一次登录校验 / 一次注册（每秒次数 = 1000 / 每轮毫秒），对比调优前的实现与用户记录缓存
+    void dbLogin_data();
+    void dbLogin();
+    void dbRegister_data();
+    void dbRegister();
+
+    // 会话录制：一个30fps房间一秒的数据（视频+音频+设备）追加 + 一次 group commit；
+    // 十万条记录的录制中随机按时间定位
+    void recordingAppend_data();
+    void recordingAppend();
+    void recordingSeek();
+
+    // 设备时序库：每轮写入1万个点（100个序列）；一周数据上的范围查询（原始点/1分钟汇总/聚合/降采样图表查询）
+    void deviceIngest();
+    void deviceQuery_data();
+    void deviceQuery();
+
+    void cleanup();
+
+private:
+    // 建立一对环回连接，服务端一侧交给 hub 的传输层
+    void connectPeer(RoomHub& hub);
+    // 建立 n 对环回连接并加入同一个房间
+    void setupRoom(RoomHub& hub, int n);
+    void drainPeers();
+    // 在临时目录中建立调优前（旧表结构/默认日志模式）与调优后（DatabaseManager）两个库并预置用户
+    void setupDatabases();
+
+    QTcpServer listener_;
+    QList<QTcpSocket*> peers_;   // 接收方（客户端一侧）；服务端一侧由 hub 的传输层持有
+    QTemporaryDir dbDir_;
+    QTemporaryDir recDir_;
+    bool dbReady_ = false;
+};
@@ -2,6 +2,8 @@
 // ===============================================
 // 客户端连接封装（两端共用一份拷贝）
 // 提供：connectTo(host,port)、sendPacket(type,json,bin)、信号 packetArrived
+// 断线重连：登录成功后保存服务器下发的会话 token，断线时在宽限期内自动重连并发送
+// MSG_RESUME_SESSION，服务器恢复身份与房间并补发错过的聊天，界面层无需重新登录/加入
 // ===============================================
 #include <QtCore>
 #include <QtNetwork>
@@ -12,16 +14,56 @@ class ClientConn : public QObject {
 public:
     explicit ClientConn(QObject* parent=nullptr); // 构造：初始化QTcpSocket并连接信号
     void connectTo(const QString& host, quint16 port); // 主动发起到服务器的TCP连接
-    void send(quint16 type, const QJsonObject& json, const QByteArray& bin = QByteArray()); // 发送一个协议包
+    // 发送一个协议包；重连/恢复期间除暂存的文本/控制消息外一律丢弃，返回 false
+    bool send(quint16 type, const QJsonObject& json, const QByteArray& bin = QByteArray());
+    void setPreferCbor(bool on) { preferCbor_ = on; } // 登录时是否请求CBOR消息体（默认开启）
+    void setPreferFragments(bool on) { preferFragments_ = on; } // 登录时是否声明支持分片帧（默认开启）
+    void setAutoReconnect(bool on) { autoReconnect_ = on; } // 断线后自动重连并恢复会话（默认开启）
+    void disconnectFromServer(); // 主动断开：丢弃会话，不再自动重连
+    BodyEncoding bodyEncoding() const { return encoding_; }
 signals: // 对外信号（供UI层连接）
     void connected();
     void disconnected();
     void packetArrived(Packet pkt);
+    void reconnecting(int attempt);             // 断线后第 attempt 次重连
+    void sessionResumed(const QString& roomId); // 会话已恢复（随后收到补发的聊天）
+    void sessionLost();                         // 会话过期或超出宽限期，需要重新登录（连接可能仍在，但未认证）
 private slots: // 内部槽函数（socket事件）
     void onReadyRead();
     void onConnected();
     void onDisconnected();
+    void onBytesWritten();
+    void onStateChanged(QAbstractSocket::SocketState state);
+    void tryReconnect();
 private:
+    // 待发送的分片：大帧切片后逐片写出，其他消息可以插在分片之间
+    struct PendingFragment {
+        FramedPacket frame;
+        QByteArray keepAlive; // 分片 bin 是原 bin 的视图
+    };
+    void flushFragments();
+    void scheduleReconnect();
+    void endReconnect(bool resumed);
+
     QTcpSocket sock_;
-    QByteArray buf_;
+    PacketBuffer buf_;
+    BodyEncoding encoding_ = BODY_JSON; // 服务器确认后改为CBOR
+    bool preferCbor_ = true;            // 登录时声明支持CBOR
+    bool preferFragments_ = true;       // 登录时声明支持分片帧
+    bool fragments_ = false;            // 服务器确认后，大 bin 按分片发送
+    quint32 nextStreamId_ = 0;
+    QList<PendingFragment> pendingFragments_;
+
+    // 断线重连
+    QString host_;
+    quint16 port_ = 0;
+    bool autoReconnect_ = true;
+    QString sessionToken_;              // 登录/恢复成功响应中的 "sessionToken"
+    int sessionGraceMs_ = 30000;        // 服务器保留会话的时长（"sessionGraceMs"）
+    QTimer reconnectTimer_;
+    QElapsedTimer reconnectClock_;      // 自断线起计时，有效表示正在重连
+    int reconnectAttempt_ = 0;
+    bool attempting_ = false;           // 一次重连尝试进行中（connectToHost 已调用）
+    bool resumePending_ = false;        // 已发送 MSG_RESUME_SESSION，等待结果
+    QList<QPair<quint16, QJsonObject>> outbox_; // 重连期间暂存的文本/控制消息，恢复后发出
 };
@@ -18,7 +18,7 @@ MainWindow::MainWindow() {
     auto row2 = new QHBoxLayout;
     edUser = new QLineEdit("expert-B");
     edRoom = new QLineEdit("R123");
-    QPushButton* btnJoin = new QPushButton("加入工单");
+    btnJoin = new QPushButton("加入工单");
     row2->addWidget(new QLabel("User:")); row2->addWidget(edUser);
     row2->addWidget(new QLabel("RoomId:")); row2->addWidget(edRoom);
     row2->addWidget(btnJoin);
@@ -41,12 +41,39 @@ MainWindow::MainWindow() {
     connect(btnJoin, &QPushButton::clicked, this, &MainWindow::onJoin);
     connect(btnSend, &QPushButton::clicked, this, &MainWindow::onSendText);
     connect(&conn_, &ClientConn::packetArrived, this, &MainWindow::onPkt);
+    connect(&conn_, &ClientConn::reconnecting, this, &MainWindow::onReconnecting);
+    connect(&conn_, &ClientConn::sessionResumed, this, &MainWindow::onSessionResumed);
+    connect(&conn_, &ClientConn::sessionLost, this, &MainWindow::onSessionLost);
+}
+
+// 状态栏显示连接/会话状态；重连期间禁用加入按钮（加入请求会被丢弃）
+void MainWindow::setSessionState(const QString& text, bool canJoin) {
+    statusBar()->showMessage(text);
+    btnJoin->setEnabled(canJoin);
+}
+
+/** 槽：断线重连中（文本消息暂存，恢复后发出） */
+void MainWindow::onReconnecting(int attempt) {
+    setSessionState(QString("连接中断，正在重连（第%1次）...").arg(attempt), false);
+}
+
+/** 槽：会话已恢复，房间不变 */
+void MainWindow::onSessionResumed(const QString& roomId) {
+    setSessionState(QString("已重新连接，房间 %1").arg(roomId), true);
+    txtLog->append(QString("[会话已恢复] 房间 %1").arg(roomId));
+}
+
+/** 槽：会话失效（超出宽限期或服务器拒绝恢复），需要重新连接并加入工单 */
+void MainWindow::onSessionLost() {
+    setSessionState("会话已失效，请重新连接并加入工单", true);
+    txtLog->append("[会话已失效] 请点击“连接”后重新加入工单");
 }
 
 // 连接到服务器（使用Host/Port）
 /** 槽：连接服务器 */
 void MainWindow::onConnect() {
     conn_.connectTo(edHost->text(), edPort->text().toUShort());
+    setSessionState("正在连接...", true);
     txtLog->append("Connecting...");
 }
 // 加入工单会议（发送房间号与用户名到服务器）
@@ -54,7 +81,8 @@ void MainWindow::onConnect() {
 void MainWindow::onJoin() {
     QJsonObject j{{"roomId", edRoom->text()},
                   {"user", edUser->text()}};
-    conn_.send(MSG_JOIN_WORKORDER, j);
+    if (!conn_.send(MSG_JOIN_WORKORDER, j))
+        txtLog->append("[未发送] 正在重连，请稍后再加入工单");
 }
 /** 槽：发送文本（并在本端日志回显） */
 void MainWindow::onSendText() {
@@ -73,7 +101,8 @@ QJsonObject j{{"roomId", edRoom->text()},
         txtLog->append(s);
     } while(0);
 
-    conn_.send(MSG_TEXT, j);
+    if (!conn_.send(MSG_TEXT, j))
+        txtLog->append("[未发送] 连接中断，消息未发出");
     edInput->clear();
 }
 
@@ -82,12 +111,12 @@ QJsonObject j{{"roomId", edRoom->text()},
 void MainWindow::onPkt(Packet p) {
     if (p.type == MSG_TEXT) {
         QString s = QString("[%1] %2: %3")
-            .arg(p.json.value("roomId").toString())
-            .arg(p.json.value("sender").toString())
-            .arg(p.json.value("content").toString());
+            .arg(p.json().value("roomId").toString())
+            .arg(p.json().value("sender").toString())
+            .arg(p.json().value("content").toString());
         txtLog->append(s);
     } else if (p.type == MSG_SERVER_EVENT) {
-        txtLog->append(QString("[server] %1").arg(QString::fromUtf8(QJsonDocument(p.json).toJson(QJsonDocument::Compact))));
+        txtLog->append(QString("[server] %1").arg(QString::fromUtf8(toJsonBytes(p.json()))));
     } else {
         txtLog->append(QString("[type %1] recv").arg(p.type));
     }
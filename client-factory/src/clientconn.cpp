@@ -1,32 +1,179 @@
 #include "clientconn.h"
 
+// 重连退避：200ms 起每次翻倍，最长 5s；宽限期内一直重试
+static const int kReconnectInitialMs = 200;
+static const int kReconnectMaxMs = 5000;
+// 重连期间最多暂存的文本/控制消息数（音视频/设备数据直接丢弃）
+static const int kMaxOutbox = 64;
+
 // 构造函数：创建socket并挂载事件回调
 ClientConn::ClientConn(QObject* parent) : QObject(parent) {
     connect(&sock_, &QTcpSocket::readyRead, this, &ClientConn::onReadyRead);
     connect(&sock_, &QTcpSocket::connected,  this, &ClientConn::onConnected);
     connect(&sock_, &QTcpSocket::disconnected, this, &ClientConn::onDisconnected);
+    connect(&sock_, &QTcpSocket::bytesWritten, this, &ClientConn::onBytesWritten);
+    connect(&sock_, &QAbstractSocket::stateChanged, this, &ClientConn::onStateChanged);
+    reconnectTimer_.setSingleShot(true);
+    connect(&reconnectTimer_, &QTimer::timeout, this, &ClientConn::tryReconnect);
 }
 
-// 连接到指定主机端口
+// 连接到指定主机端口（新的连接需要重新登录，丢弃旧会话）
 void ClientConn::connectTo(const QString& host, quint16 port) {
+    host_ = host;
+    port_ = port;
+    sessionToken_.clear();
+    endReconnect(false);
     sock_.connectToHost(host, port);
 }
 
-// 发送协议包：封包为 [type|len|json|bin] 写入socket
-void ClientConn::send(quint16 type, const QJsonObject& json, const QByteArray& bin) {
-    sock_.write(buildPacket(type, json, bin));
+void ClientConn::disconnectFromServer() {
+    sessionToken_.clear();
+    endReconnect(false);
+    sock_.disconnectFromHost();
+}
+
+// 发送协议包：封包为 [len|type|jsonSize] 头部 + json + bin 三段，按iovec写入socket（不复制bin）
+// 登录包附带 "encodings"/"fragments" 声明支持的消息体编码与分片帧，服务器确认前一律用JSON、不分片
+// 分片确认后，超过 kFragmentThreshold 的 bin 切成分片，随socket可写逐片写出
+bool ClientConn::send(quint16 type, const QJsonObject& json, const QByteArray& bin) {
+    // 重连/恢复期间：文本与控制指令暂存，恢复后按序发出；其余（含登录/加入）丢弃
+    if (reconnectClock_.isValid()) {
+        if ((type == MSG_TEXT || type == MSG_CONTROL) && bin.isEmpty() && outbox_.size() < kMaxOutbox) {
+            outbox_.append(qMakePair(type, json));
+            return true;
+        }
+        return false;
+    }
+    if (type == MSG_LOGIN && (preferCbor_ || preferFragments_)) {
+        QJsonObject j = json;
+        if (preferCbor_)
+            j.insert("encodings", QJsonArray{"cbor", "json"});
+        if (preferFragments_)
+            j.insert("fragments", true);
+        return writeFramed(&sock_, framePacket(type, j, bin, encoding_)) >= 0;
+    }
+    if (fragments_ && bin.size() > kFragmentThreshold) {
+        const auto frags = fragmentPacket(type, encodeBody(json, encoding_), bin, ++nextStreamId_, encoding_);
+        for (const FramedPacket& f : frags)
+            pendingFragments_.append(PendingFragment{f, bin});
+        flushFragments();
+        return true;
+    }
+    return writeFramed(&sock_, framePacket(type, json, bin, encoding_)) >= 0;
+}
+
+// 只在socket发送缓冲较空时写下一个分片：之后调用 send() 的小消息（音频/控制）最多排在一个分片之后
+void ClientConn::flushFragments() {
+    while (!pendingFragments_.isEmpty() && sock_.bytesToWrite() < kFragmentSize)
+        writeFramed(&sock_, pendingFragments_.takeFirst().frame);
+}
+
+void ClientConn::onBytesWritten() { flushFragments(); }
+
+// socket已连接 -> 转发connected信号；重连成功时先凭 token 恢复会话
+void ClientConn::onConnected() {
+    if (attempting_) {
+        attempting_ = false;
+        resumePending_ = true;
+        QJsonObject j{{"token", sessionToken_}};
+        if (preferCbor_)
+            j.insert("encodings", QJsonArray{"cbor", "json"});
+        if (preferFragments_)
+            j.insert("fragments", true);
+        writeFramed(&sock_, framePacket(MSG_RESUME_SESSION, j, QByteArray(), BODY_JSON));
+    }
+    emit connected();
+}
+// socket断开 -> 转发disconnected信号；持有会话时开始自动重连
+void ClientConn::onDisconnected() {
+    encoding_ = BODY_JSON;
+    fragments_ = false;
+    pendingFragments_.clear();
+    buf_ = PacketBuffer();
+    resumePending_ = false;
+    emit disconnected();
+    if (autoReconnect_ && !sessionToken_.isEmpty()) {
+        if (!reconnectClock_.isValid()) {
+            reconnectClock_.start();
+            reconnectAttempt_ = 0;
+        }
+        scheduleReconnect();
+    }
+}
+
+// 一次重连尝试失败（未连上即回到未连接状态）：退避后再试
+void ClientConn::onStateChanged(QAbstractSocket::SocketState state) {
+    if (state == QAbstractSocket::UnconnectedState && attempting_) {
+        attempting_ = false;
+        scheduleReconnect();
+    }
+}
+
+void ClientConn::scheduleReconnect() {
+    if (reconnectClock_.elapsed() > sessionGraceMs_) {
+        sessionToken_.clear();
+        endReconnect(false);
+        emit sessionLost();
+        return;
+    }
+    const int delay = qMin(kReconnectMaxMs, kReconnectInitialMs << qMin(reconnectAttempt_, 5));
+    reconnectTimer_.start(delay);
+}
+
+void ClientConn::tryReconnect() {
+    attempting_ = true;
+    emit reconnecting(++reconnectAttempt_);
+    sock_.connectToHost(host_, port_);
 }
 
-// socket已连接 -> 转发connected信号
-void ClientConn::onConnected() { emit connected(); }
-// socket断开 -> 转发disconnected信号
-void ClientConn::onDisconnected() { emit disconnected(); }
+// 结束重连：恢复成功时发出暂存的消息，否则丢弃
+void ClientConn::endReconnect(bool resumed) {
+    reconnectTimer_.stop();
+    reconnectClock_.invalidate();
+    reconnectAttempt_ = 0;
+    attempting_ = false;
+    resumePending_ = false;
+    const auto outbox = outbox_;
+    outbox_.clear();
+    if (resumed) {
+        for (const auto& m : outbox)
+            send(m.first, m.second);
+    }
+}
 
 // 收到数据 -> 累加到缓冲并尽可能解析成Packet，逐个发出
 void ClientConn::onReadyRead() {
     buf_.append(sock_.readAll());
     QVector<Packet> pkts;
-    if (drainPackets(buf_, pkts)) {
-        for (auto& p : pkts) emit packetArrived(p);
+    if (buf_.drain(pkts)) {
+        for (auto& p : pkts) {
+            // 登录成功响应中的 "bodyEncoding" 确认协商结果
+            if (p.type == MSG_SERVER_EVENT && p.stringField("bodyEncoding") == "cbor")
+                encoding_ = BODY_CBOR;
+            if (p.type == MSG_SERVER_EVENT && preferFragments_ && p.json().value("fragments").toBool())
+                fragments_ = true;
+            if (p.type == MSG_SERVER_EVENT) {
+                // 登录/恢复成功响应携带会话 token 与宽限期
+                const QString token = p.stringField("sessionToken");
+                if (!token.isEmpty()) {
+                    sessionToken_ = token;
+                    sessionGraceMs_ = p.intField("sessionGraceMs", sessionGraceMs_);
+                }
+                // 恢复请求之后的第一条服务器事件即恢复结果
+                if (resumePending_) {
+                    const bool resumed = p.intField("code", -1) == 0;
+                    if (!resumed)
+                        sessionToken_.clear();
+                    endReconnect(resumed);
+                    emit packetArrived(p);
+                    if (resumed)
+                        emit sessionResumed(p.stringField("roomId"));
+                    else
+                        emit sessionLost();
+                    continue;
+                }
+            }
+            emit packetArrived(p);
+        }
     }
 }
@@ -18,9 +18,14 @@ private slots:
     void onJoin();      // 加入工单（房间）
     void onSendText(); // 发送文本消息（并在本端回显）
     void onPkt(Packet p); // 处理收到的数据包
+    void onReconnecting(int attempt);          // 断线重连中：暂停加入，文本暂存
+    void onSessionResumed(const QString& roomId);
+    void onSessionLost();                      // 会话失效：需要重新连接/加入
 private:
     ClientConn conn_;
     // UI控件
     QLineEdit *edHost, *edPort, *edUser, *edRoom, *edInput;
     QTextEdit *txtLog;
+    QPushButton *btnJoin;
+    void setSessionState(const QString& text, bool canJoin);
 };
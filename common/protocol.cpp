@@ -1,94 +1,628 @@
 #include "protocol.h"
 
+#ifdef Q_OS_UNIX
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 // 头字段大小常量（以便统一维护）
 static const int kLenFieldSize = 4; // uint32 length（大端）
 static const int kTypeSize     = 2; // uint16
 static const int kJsonSizeSize = 4; // uint32
+static const int kFragmentExtSize = 12; // 分片头：streamId + binOffset + binTotal（各 uint32）
 
-QByteArray buildPacket(quint16 type,
-                       const QJsonObject& json,
-                       const QByteArray& bin)
+// 分片重组的防御上限
+static const quint32 kMaxFragmentedBin = 64 * 1024 * 1024;
+static const int kMaxPendingStreams = 16;
+static const quint64 kMaxReassemblyBytes = 64 * 1024 * 1024; // 每个连接所有重组中的流声明的 bin 总量
+
+QByteArray encodeBody(const QJsonObject& j, BodyEncoding encoding)
+{
+    if (encoding == BODY_CBOR)
+        return QCborValue(QCborMap::fromJsonObject(j)).toCbor();
+    return toJsonBytes(j);
+}
+
+QJsonObject decodeBody(const QByteArray& body, BodyEncoding encoding)
 {
-    QByteArray jsonBytes = toJsonBytes(json);
-    quint32 jsonSize = static_cast<quint32>(jsonBytes.size());
-    quint32 length = static_cast<quint32>(kTypeSize + kJsonSizeSize + jsonSize + bin.size());
+    if (encoding == BODY_CBOR)
+        return QCborValue::fromCbor(body).toMap().toJsonObject();
+    return fromJsonBytes(body);
+}
 
+static QByteArray frameHeader(quint16 type, int jsonSize, int binSize)
+{
+    const quint32 length = static_cast<quint32>(kTypeSize + kJsonSizeSize + jsonSize + binSize);
+    QByteArray header(kLenFieldSize + kTypeSize + kJsonSizeSize, Qt::Uninitialized);
+    uchar* h = reinterpret_cast<uchar*>(header.data());
+    qToBigEndian<quint32>(length, h);                                 // 4B: 后续总长度（从type开始）
+    qToBigEndian<quint16>(type, h + kLenFieldSize);                   // 2B: 消息类型
+    qToBigEndian<quint32>(quint32(jsonSize), h + kLenFieldSize + kTypeSize); // 4B: JSON长度
+    return header;
+}
+
+FramedPacket framePacket(quint16 type,
+                         const QByteArray& body,
+                         const QByteArray& bin,
+                         BodyEncoding encoding)
+{
+    FramedPacket f;
+    const quint16 wireType = encoding == BODY_CBOR ? quint16(type | kTypeCborFlag) : type;
+    f.header = frameHeader(wireType, body.size(), bin.size());
+    f.json = body;
+    f.bin = bin;
+    return f;
+}
+
+FramedPacket framePacket(quint16 type,
+                         const QJsonObject& json,
+                         const QByteArray& bin,
+                         BodyEncoding encoding)
+{
+    return framePacket(type, encodeBody(json, encoding), bin, encoding);
+}
+
+QByteArray FramedPacket::flatten() const
+{
     QByteArray out;
-    out.reserve(kLenFieldSize + length);
+    out.reserve(size());
+    out.append(header);
+    out.append(json);
+    out.append(bin);
+    return out;
+}
 
-    QDataStream ds(&out, QIODevice::WriteOnly);
-    ds.setByteOrder(QDataStream::BigEndian);
+QByteArray buildPacket(quint16 type,
+                       const QJsonObject& json,
+                       const QByteArray& bin,
+                       BodyEncoding encoding)
+{
+    return framePacket(type, json, bin, encoding).flatten();
+}
 
-    ds << length;   // 4B: 后续总长度（从type开始）
-    ds << type;     // 2B: 消息类型
-    ds << jsonSize; // 4B: JSON长度
-    if (!jsonBytes.isEmpty())
-        ds.writeRawData(jsonBytes.constData(), jsonBytes.size());
-    if (!bin.isEmpty())
-        ds.writeRawData(bin.constData(), bin.size());
+QVector<FramedPacket> fragmentPacket(quint16 type,
+                                     const QByteArray& body,
+                                     const QByteArray& bin,
+                                     quint32 streamId,
+                                     BodyEncoding encoding,
+                                     int fragmentSize)
+{
+    quint16 wireType = quint16(type | kTypeFragmentFlag);
+    if (encoding == BODY_CBOR) wireType |= kTypeCborFlag;
+    const int total = bin.size();
 
+    QVector<FramedPacket> out;
+    out.reserve(total / fragmentSize + 1);
+    int off = 0;
+    do {
+        const int n = qMin(fragmentSize, total - off);
+        FramedPacket f;
+        if (off == 0) f.json = body;
+        // 分片头紧跟在10字节帧头之后，计入 length
+        f.header = frameHeader(wireType, f.json.size(), kFragmentExtSize + n);
+        f.header.resize(kFragmentHeaderSize);
+        uchar* ext = reinterpret_cast<uchar*>(f.header.data()) + kLenFieldSize + kTypeSize + kJsonSizeSize;
+        qToBigEndian<quint32>(streamId, ext);
+        qToBigEndian<quint32>(quint32(off), ext + 4);
+        qToBigEndian<quint32>(quint32(total), ext + 8);
+        f.bin = QByteArray::fromRawData(bin.constData() + off, n);
+        out.push_back(f);
+        off += n;
+    } while (off < total);
     return out;
 }
 
-bool drainPackets(QByteArray& buffer, QVector<Packet>& out)
+FramedPacket abortFragment(quint16 type, quint32 streamId)
+{
+    FramedPacket f;
+    f.header = frameHeader(quint16(type | kTypeFragmentFlag), 0, kFragmentExtSize);
+    f.header.resize(kFragmentHeaderSize);
+    uchar* ext = reinterpret_cast<uchar*>(f.header.data()) + kLenFieldSize + kTypeSize + kJsonSizeSize;
+    qToBigEndian<quint32>(streamId, ext);
+    qToBigEndian<quint32>(kFragmentAbort, ext + 4);
+    qToBigEndian<quint32>(kFragmentAbort, ext + 8);
+    return f;
+}
+
+QByteArray rewriteFragmentHeader(const Packet& fragment, quint32 streamId)
+{
+    QByteArray header(fragment.block.constData() + fragment.frameOffset, kFragmentHeaderSize);
+    qToBigEndian<quint32>(streamId, header.data() + kLenFieldSize + kTypeSize + kJsonSizeSize);
+    return header;
+}
+
+qint64 writeSegments(QIODevice* dev, const QByteArray* segs, int count)
+{
+    qint64 total = 0;
+    for (int i = 0; i < count; ++i) total += segs[i].size();
+
+    int first = 0;      // 尚未完整写出的第一段
+    qint64 skip = 0;    // 该段中已被内核接收的字节数
+
+#ifdef Q_OS_UNIX
+    auto* sock = qobject_cast<QAbstractSocket*>(dev);
+    if (sock && sock->bytesToWrite() == 0 &&
+        sock->state() == QAbstractSocket::ConnectedState &&
+        sock->socketDescriptor() != -1) {
+        struct iovec iov[8];
+        int n = 0;
+        for (int i = 0; i < count && n < 8; ++i) {
+            if (segs[i].isEmpty()) continue;
+            iov[n].iov_base = const_cast<char*>(segs[i].constData());
+            iov[n].iov_len = size_t(segs[i].size());
+            ++n;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        // MSG_NOSIGNAL：对端已关闭时不产生SIGPIPE；错误留给Qt在后续write中报告
+        ssize_t sent = n > 0 ? ::sendmsg(int(sock->socketDescriptor()), &msg,
+                                         MSG_NOSIGNAL | MSG_DONTWAIT) : 0;
+        if (sent < 0) sent = 0;
+        qint64 left = sent;
+        while (first < count && left >= segs[first].size()) {
+            left -= segs[first].size();
+            ++first;
+        }
+        skip = left;
+    }
+#endif
+
+    for (int i = first; i < count; ++i) {
+        const QByteArray& seg = segs[i];
+        const qint64 off = (i == first) ? skip : 0;
+        if (seg.size() - off <= 0) continue;
+        if (dev->write(seg.constData() + off, seg.size() - off) < 0)
+            return -1;
+    }
+    return total;
+}
+
+// 压缩阈值：已消费部分超过该值且占缓冲区一半以上时才搬移
+static const int kCompactThreshold = 64 * 1024;
+
+// 从 block 的 pos 处开始按游标解析完整包，pos 前进到第一个未消费字节
+// - 不复制 block：Packet 共享 block，json/bin 均为其内部切片
+// - 不解码JSON，只记录其切片（见 Packet::json()）
+// - 声明长度非法时把 pos 置到末尾（丢弃剩余数据，与旧实现一致）
+static bool parseFrames(const QByteArray& block, int& pos, QVector<Packet>& out)
 {
     bool produced = false;
+    const char* base = block.constData();
+    const int end = block.size();
 
     for (;;) {
-        if (buffer.size() < kLenFieldSize) break; // 连长度都不够
-
-        // 读取length（大端）但不消费
-        quint32 length = 0;
-        {
-            QDataStream peek(buffer.left(kLenFieldSize));
-            peek.setByteOrder(QDataStream::BigEndian);
-            peek >> length;
-        }
+        if (end - pos < kLenFieldSize) break; // 连长度都不够
+
+        // 直接按大端读取length，不消费也不构造QDataStream
+        const quint32 length = qFromBigEndian<quint32>(base + pos);
         if (length < (quint32)(kTypeSize + kJsonSizeSize)) {
             // 异常防御：声明的长度过小
-            buffer.clear();
+            pos = end;
             break;
         }
+        if (quint32(end - pos - kLenFieldSize) < length) break; // 半包，等待更多数据
 
+        const int frameStart = pos;
         const int totalNeed = kLenFieldSize + int(length);
-        if (buffer.size() < totalNeed) break; // 半包，等待更多数据
-
-        // 取出一个完整包块并从buffer中移除
-        QByteArray block = buffer.left(totalNeed);
-        buffer.remove(0, totalNeed);
+        pos += totalNeed;
 
-        // 解析 block
-        QDataStream ds(block);
-        ds.setByteOrder(QDataStream::BigEndian);
+        const char* hdr = base + frameStart + kLenFieldSize;
+        const quint16 wireType = qFromBigEndian<quint16>(hdr);
+        const quint32 jsonSize = qFromBigEndian<quint32>(hdr + kTypeSize);
 
-        quint32 lenField = 0; ds >> lenField; Q_UNUSED(lenField);
-        quint16 type = 0;     ds >> type;
-        quint32 jsonSize = 0; ds >> jsonSize;
-
-        // 检查jsonSize合法性
-        const int payloadBytes = totalNeed - kLenFieldSize - kTypeSize - kJsonSizeSize;
-        if (jsonSize > (quint32)payloadBytes) {
+        // 检查jsonSize合法性（分片帧还要扣除分片头）
+        const bool isFragment = (wireType & kTypeFragmentFlag) != 0;
+        const int extSize = isFragment ? kFragmentExtSize : 0;
+        const int payloadBytes = totalNeed - kLenFieldSize - kTypeSize - kJsonSizeSize - extSize;
+        if (payloadBytes < 0 || jsonSize > (quint32)payloadBytes) {
             // 非法，丢弃
             continue;
         }
 
-        QByteArray jsonBytes(jsonSize, Qt::Uninitialized);
-        if (jsonSize > 0) {
-            ds.readRawData(jsonBytes.data(), jsonBytes.size());
-        }
-        QByteArray bin;
+        const int jsonOffset = frameStart + kLenFieldSize + kTypeSize + kJsonSizeSize + extSize;
         const int binSize = payloadBytes - int(jsonSize);
-        if (binSize > 0) {
-            bin = block.right(binSize);
-        }
 
         Packet pkt;
-        pkt.type = type;
-        pkt.json = fromJsonBytes(jsonBytes);
-        pkt.bin  = bin;
+        pkt.type = quint16(wireType & ~(kTypeCborFlag | kTypeFragmentFlag));
+        pkt.encoding = (wireType & kTypeCborFlag) ? BODY_CBOR : BODY_JSON;
+        if (isFragment) {
+            const char* ext = hdr + kTypeSize + kJsonSizeSize;
+            pkt.fragment = true;
+            pkt.streamId = qFromBigEndian<quint32>(ext);
+            pkt.fragmentOffset = qFromBigEndian<quint32>(ext + 4);
+            pkt.binTotal = qFromBigEndian<quint32>(ext + 8);
+        }
+        pkt.block = block;
+        pkt.frameOffset = frameStart;
+        pkt.frameSize = totalNeed;
+        if (jsonSize > 0)
+            pkt.jsonBytes = QByteArray::fromRawData(base + jsonOffset, int(jsonSize));
+        if (binSize > 0)
+            pkt.bin = QByteArray::fromRawData(base + jsonOffset + int(jsonSize), binSize);
         out.push_back(std::move(pkt));
         produced = true;
     }
 
     return produced;
 }
+
+bool drainPackets(QByteArray& buffer, QVector<Packet>& out)
+{
+    int pos = 0;
+    const bool produced = parseFrames(buffer, pos, out);
+    if (pos >= buffer.size())
+        buffer.clear();
+    else if (pos > 0)
+        buffer = buffer.mid(pos); // 只复制未消费的尾部，已产出的Packet继续持有原块
+    return produced;
+}
+
+void PacketBuffer::append(const QByteArray& chunk)
+{
+    if (chunk.isEmpty()) return;
+
+    if (rd_ >= buf_.size()) {
+        // 无残留数据：直接共享新块，不复制
+        buf_ = chunk;
+        rd_ = 0;
+        return;
+    }
+
+    if (!buf_.isDetached()) {
+        // 块仍被已产出的Packet共享，append会触发整块深拷贝；改为只复制未消费的尾部
+        buf_ = buf_.mid(rd_);
+        rd_ = 0;
+    } else if (rd_ >= kCompactThreshold && rd_ * 2 >= buf_.size()) {
+        // 已消费部分足够大时才压缩，摊还为O(1)
+        buf_.remove(0, rd_);
+        rd_ = 0;
+    }
+    buf_.append(chunk);
+}
+
+bool PacketBuffer::drain(QVector<Packet>& out)
+{
+    const int first = out.size();
+    bool produced = parseFrames(buf_, rd_, out);
+    if (rd_ >= buf_.size()) {
+        // 全部消费：释放对块的引用（块由已产出的Packet继续持有）
+        buf_.clear();
+        rd_ = 0;
+    }
+    if (produced)
+        produced = assembleFragments(out, first);
+    return produced;
+}
+
+// 处理 out[first..] 中的分片帧：交给重组，按需保留分片本身，完整包紧跟在最后一个分片之后
+// 没有分片时只做一次线性检查
+bool PacketBuffer::assembleFragments(QVector<Packet>& out, int first)
+{
+    int i = first;
+    while (i < out.size() && !out.at(i).fragment) ++i;
+    if (i == out.size()) return true;
+
+    QVector<Packet> tail;
+    tail.reserve(out.size() - i);
+    for (int k = i; k < out.size(); ++k)
+        tail.push_back(std::move(out[k]));
+    out.resize(i);
+
+    for (Packet& p : tail) {
+        if (!p.fragment) {
+            out.push_back(std::move(p));
+            continue;
+        }
+        Packet done;
+        const bool complete = assemble(p, done);
+        for (Packet& a : aborted_)
+            out.push_back(std::move(a));
+        aborted_.clear();
+        if (deliverFragments_)
+            out.push_back(std::move(p));
+        if (complete)
+            out.push_back(std::move(done));
+    }
+    return out.size() > first;
+}
+
+// 拷贝一个分片到重组块；最后一个分片到达时在 done 中返回完整包
+// - 未开启重组（setReassemble(false)）时丢弃，不分配任何内存
+// - 中止帧丢弃该流已收到的部分
+// - 分片必须按顺序到达（binOffset 等于已收到的字节数），重复、重叠、越界的分片使该流作废
+// - 重组块随分片到达逐步增长，不按对端声明的 binTotal 预先分配；声明总量受每连接上限约束
+bool PacketBuffer::assemble(const Packet& f, Packet& done)
+{
+    if (!reassemble_) return false;
+    auto it = assemblies_.find(f.streamId);
+    if (f.fragmentAbort()) {
+        if (it != assemblies_.end())
+            dropAssembly(it, false); // 中止帧本身会交付，不再另发
+        return false;
+    }
+    if (f.fragmentOffset == 0) {
+        if (it != assemblies_.end())
+            dropAssembly(it, true);
+        if (f.binTotal > kMaxFragmentedBin) return false;
+        // 并发流数或声明总量超限时淘汰最早开始的流
+        while (!assemblies_.isEmpty() && (assemblies_.size() >= kMaxPendingStreams
+                                          || assemblyBytes_ + f.binTotal > kMaxReassemblyBytes)) {
+            auto oldest = assemblies_.begin();
+            for (auto j = assemblies_.begin(); j != assemblies_.end(); ++j)
+                if (j->seq < oldest->seq) oldest = j;
+            dropAssembly(oldest, true);
+        }
+        const quint16 wireType = f.encoding == BODY_CBOR ? quint16(f.type | kTypeCborFlag) : f.type;
+        Assembly a;
+        a.block = frameHeader(wireType, f.jsonBytes.size(), int(f.binTotal));
+        a.block.append(f.jsonBytes);
+        a.type = f.type;
+        a.binTotal = f.binTotal;
+        a.seq = ++assemblySeq_;
+        assemblyBytes_ += f.binTotal;
+        it = assemblies_.insert(f.streamId, a);
+    }
+    if (it == assemblies_.end()) return false;
+
+    Assembly& a = it.value();
+    if (f.fragmentOffset != a.received
+            || quint64(a.received) + quint64(f.bin.size()) > a.binTotal) {
+        dropAssembly(it, true);
+        return false;
+    }
+    a.block.append(f.bin);
+    a.received += quint32(f.bin.size());
+    if (a.received < a.binTotal) return false;
+
+    const QByteArray block = a.block;
+    dropAssembly(it, false);
+    QVector<Packet> whole;
+    int pos = 0;
+    if (!parseFrames(block, pos, whole)) return false;
+    done = std::move(whole.first());
+    done.reassembled = true;
+    done.streamId = f.streamId;
+    return true;
+}
+
+void PacketBuffer::dropAssembly(QHash<quint32, Assembly>::iterator it, bool notify)
+{
+    if (notify && deliverFragments_) {
+        Packet pkt;
+        pkt.type = it->type;
+        pkt.fragment = true;
+        pkt.streamId = it.key();
+        pkt.fragmentOffset = kFragmentAbort;
+        pkt.binTotal = kFragmentAbort;
+        aborted_.append(pkt);
+    }
+    assemblyBytes_ -= it->binTotal;
+    assemblies_.erase(it);
+}
+
+void PacketBuffer::setReassemble(bool on)
+{
+    reassemble_ = on;
+    if (!on) {
+        assemblies_.clear();
+        assemblyBytes_ = 0;
+    }
+}
+
+const QJsonObject& Packet::json() const
+{
+    if (!jsonDecoded_) {
+        if (!jsonBytes.isEmpty())
+            json_ = decodeBody(jsonBytes, encoding);
+        jsonDecoded_ = true;
+    }
+    return json_;
+}
+
+// CBOR消息体：用流式读取器只扫描顶层map的键，命中后只解码该值
+static bool cborFindField(const QByteArray& body, const char* key, QCborValue& out)
+{
+    QCborStreamReader r(body);
+    if (!r.isMap() || !r.enterContainer()) return false;
+    const QLatin1String wanted(key);
+    while (r.lastError() == QCborError::NoError && r.hasNext()) {
+        if (!r.isString()) return false;
+        QString name;
+        auto chunk = r.readString();
+        while (chunk.status == QCborStreamReader::Ok) {
+            name += chunk.data;
+            chunk = r.readString();
+        }
+        if (chunk.status == QCborStreamReader::Error) return false;
+        if (name == wanted) {
+            out = QCborValue::fromCbor(r);
+            return r.lastError() == QCborError::NoError;
+        }
+        if (!r.next()) return false; // 跳过不关心的值
+    }
+    return false;
+}
+
+QString Packet::stringField(const char* key) const
+{
+    QString v;
+    if (!jsonDecoded_) {
+        if (encoding == BODY_CBOR) {
+            QCborValue cv;
+            if (cborFindField(jsonBytes, key, cv) && cv.isString())
+                return cv.toString();
+        } else if (JsonFieldScanner(jsonBytes).string(key, v)) {
+            return v;
+        }
+    }
+    return json().value(QLatin1String(key)).toString();
+}
+
+int Packet::intField(const char* key, int defaultValue) const
+{
+    if (!jsonDecoded_) {
+        if (encoding == BODY_CBOR) {
+            QCborValue cv;
+            if (cborFindField(jsonBytes, key, cv)) {
+                if (cv.isInteger()) return int(cv.toInteger());
+                if (cv.isDouble()) return int(cv.toDouble());
+            }
+        } else {
+            qint64 v = 0;
+            if (JsonFieldScanner(jsonBytes).integer(key, v))
+                return int(v);
+        }
+    }
+    return json().value(QLatin1String(key)).toInt(defaultValue);
+}
+
+double Packet::doubleField(const char* key, bool* ok) const
+{
+    if (ok) *ok = true;
+    if (!jsonDecoded_) {
+        if (encoding == BODY_CBOR) {
+            QCborValue cv;
+            if (cborFindField(jsonBytes, key, cv)) {
+                if (cv.isDouble()) return cv.toDouble();
+                if (cv.isInteger()) return double(cv.toInteger());
+            }
+        } else {
+            double v = 0;
+            if (JsonFieldScanner(jsonBytes).number(key, v))
+                return v;
+        }
+    }
+    const QJsonValue v = json().value(QLatin1String(key));
+    if (ok) *ok = v.isDouble();
+    return v.toDouble();
+}
+
+// ---- JsonFieldScanner：顶层键扫描 ----
+
+static int skipWs(const char* p, int i, int n)
+{
+    while (i < n && (p[i] == ' ' || p[i] == '\t' || p[i] == '\n' || p[i] == '\r')) ++i;
+    return i;
+}
+
+// i 指向开头的引号；返回结束引号之后的位置，失败返回 -1
+static int skipString(const char* p, int i, int n, bool* escaped = nullptr)
+{
+    ++i;
+    while (i < n) {
+        if (p[i] == '\\') {
+            if (escaped) *escaped = true;
+            i += 2;
+            continue;
+        }
+        if (p[i] == '"') return i + 1;
+        ++i;
+    }
+    return -1;
+}
+
+// 跳过任意一个JSON值；返回值之后的位置，失败返回 -1
+static int skipValue(const char* p, int i, int n)
+{
+    if (i >= n) return -1;
+    if (p[i] == '"') return skipString(p, i, n);
+    if (p[i] == '{' || p[i] == '[') {
+        int depth = 0;
+        while (i < n) {
+            const char ch = p[i];
+            if (ch == '"') {
+                i = skipString(p, i, n);
+                if (i < 0) return -1;
+                continue;
+            }
+            if (ch == '{' || ch == '[') ++depth;
+            else if (ch == '}' || ch == ']') {
+                if (--depth == 0) return i + 1;
+            }
+            ++i;
+        }
+        return -1;
+    }
+    // 数字 / true / false / null
+    while (i < n && p[i] != ',' && p[i] != '}' && p[i] != ']' &&
+           p[i] != ' ' && p[i] != '\t' && p[i] != '\n' && p[i] != '\r')
+        ++i;
+    return i;
+}
+
+bool JsonFieldScanner::find(const char* key, int& begin, int& end) const
+{
+    const char* p = json_.constData();
+    const int n = json_.size();
+    const int keyLen = int(qstrlen(key));
+
+    int i = skipWs(p, 0, n);
+    if (i >= n || p[i] != '{') return false;
+    ++i;
+    for (;;) {
+        i = skipWs(p, i, n);
+        if (i >= n || p[i] != '"') return false; // 包括空对象 '}'
+        const int keyBegin = i + 1;
+        i = skipString(p, i, n);
+        if (i < 0) return false;
+        const bool match = (i - 1 - keyBegin == keyLen) &&
+                           memcmp(p + keyBegin, key, size_t(keyLen)) == 0;
+        i = skipWs(p, i, n);
+        if (i >= n || p[i] != ':') return false;
+        i = skipWs(p, i + 1, n);
+        const int valBegin = i;
+        i = skipValue(p, i, n);
+        if (i < 0) return false;
+        if (match) {
+            begin = valBegin;
+            end = i;
+            return true;
+        }
+        i = skipWs(p, i, n);
+        if (i >= n || p[i] != ',') return false;
+        ++i;
+    }
+}
+
+bool JsonFieldScanner::contains(const char* key) const
+{
+    int b = 0, e = 0;
+    return find(key, b, e);
+}
+
+bool JsonFieldScanner::string(const char* key, QString& out) const
+{
+    int b = 0, e = 0;
+    if (!find(key, b, e)) return false;
+    const char* p = json_.constData();
+    if (e - b < 2 || p[b] != '"') return false;
+    bool escaped = false;
+    if (skipString(p, b, e, &escaped) != e || escaped) return false;
+    out = QString::fromUtf8(p + b + 1, e - b - 2);
+    return true;
+}
+
+bool JsonFieldScanner::number(const char* key, double& out) const
+{
+    int b = 0, e = 0;
+    if (!find(key, b, e)) return false;
+    bool ok = false;
+    out = QByteArray::fromRawData(json_.constData() + b, e - b).toDouble(&ok);
+    return ok;
+}
+
+bool JsonFieldScanner::integer(const char* key, qint64& out) const
+{
+    int b = 0, e = 0;
+    if (!find(key, b, e)) return false;
+    const QByteArray raw = QByteArray::fromRawData(json_.constData() + b, e - b);
+    bool ok = false;
+    out = raw.toLongLong(&ok);
+    if (ok) return true;
+    const double d = raw.toDouble(&ok);
+    if (!ok || d != double(qint64(d))) return false;
+    out = qint64(d);
+    return true;
+}
@@ -4,9 +4,9 @@
 // 统一协议（打包/拆包）最小实现
 // 结构: [uint32 length][uint16 type][uint32 jsonSize][jsonBytes][bin...]
 // - length: 从 type 开始的总字节数（大端序）
-// - type  : 消息类型（见枚举 MsgType）
-// - jsonSize: JSON字节长度（UTF-8, Compact）
-// - jsonBytes: 固定存在的JSON（至少包含roomId/ts等字段）
+// - type  : 消息类型（见枚举 MsgType）；最高位 kTypeCborFlag 表示消息体为CBOR
+// - jsonSize: 消息体字节长度（默认 JSON UTF-8 Compact；协商后可为CBOR）
+// - jsonBytes: 固定存在的消息体（至少包含roomId/ts等字段）
 // - bin   : 可选二进制负载（如JPEG/PCM）
 // ===============================================
 
@@ -18,22 +18,120 @@ enum MsgType : quint16 {
     MSG_LOGIN            = 2,   // 登录
     MSG_CREATE_WORKORDER = 3,   // 创建工单
     MSG_JOIN_WORKORDER   = 4,   // 加入工单（设置roomId + username）
+    MSG_RESUME_SESSION   = 5,   // 断线重连：携带登录时下发的 sessionToken，恢复身份与房间（免登录、免重新加入）
 
     MSG_TEXT             = 10,  // 文本聊天（先跑通端到端）
     // 设备/音视频后续添加：
     MSG_DEVICE_DATA      = 20,  // 设备数据（纯JSON即可）
+    MSG_DEVICE_QUERY     = 21,  // 查询当前房间（工单）某设备指标的历史：{"deviceId","type","fromMs","toMs","points","reqId"}
+                                //   缺省 toMs=现在、fromMs=toMs-1小时、points=1000（上限10000），以 MSG_DEVICE_SERIES 返回
+                                //   fromMs/toMs 须为 0 到 2100 年之间的毫秒时间戳，否则回 400
+    MSG_DEVICE_SERIES    = 22,  // 查询结果：{"reqId","deviceId","type","fromMs","toMs","source","layout","count","timeUnitMs","scanned"}
+                                //   bin 为大端定长记录，时间为相对 fromMs 的偏移（单位 timeUnitMs）：
+                                //   layout "points"：[u32 偏移][f32 值]，每条8字节（source 为 raw/lttb）
+                                //   layout "buckets"：[u32 桶起点偏移][f32 min][f32 max][f32 avg]，每条16字节（source 为 1s/1m/1h）
     MSG_VIDEO_FRAME      = 30,  // bin: JPEG
     MSG_AUDIO_FRAME      = 40,  // bin: PCM S16LE
     MSG_CONTROL          = 50,  // 控制指令（可选加分）
+    MSG_REPLAY_CONTROL   = 60,  // 把当前房间（工单）的录制回放到房间：{"action":"start|pause|resume|seek|speed|stop",
+                                //   "speed"(1-16),"offsetMs"}，"ticket" 可省略、只能是当前 roomId；
+                                //   结果以 MSG_SERVER_EVENT 的 "replay" 字段返回
 
     MSG_SERVER_EVENT     = 90   // 服务器提示/错误/房间事件等
 };
 
+// 消息体编码：默认紧凑JSON；登录时客户端在 "encodings" 中声明支持 "cbor"，
+// 服务器在登录成功响应里以 "bodyEncoding":"cbor" 确认后，双方改用CBOR（逻辑字段不变）。
+// 每帧自带编码标记，接收方按帧解码，因此旧客户端始终只会收到JSON。
+enum BodyEncoding : quint8 {
+    BODY_JSON = 0,
+    BODY_CBOR = 1
+};
+static const quint16 kTypeCborFlag = 0x8000; // type字段最高位：消息体为CBOR
+
+// 分片帧：大 bin 切成固定大小的分片，以 stream id + 偏移 标识，由接收方的 PacketBuffer 重组
+// 帧格式：[length][type|kTypeFragmentFlag][jsonSize][streamId][binOffset][binTotal][json][chunk]
+// - 消息体只随第一个分片（binOffset==0）发送，其余分片 jsonSize 为 0
+// - 同一连接上分片之间可以穿插任意其他帧，音频/控制不必等整帧视频发完
+// - 登录时协商（"fragments":true），未声明支持的客户端始终只收到完整帧
+static const quint16 kTypeFragmentFlag = 0x4000;
+static const int kFragmentSize = 16 * 1024;      // 每个分片的 bin 字节数
+static const int kFragmentThreshold = 64 * 1024; // bin 超过此值才分片
+static const int kFragmentHeaderSize = 22;       // 分片帧头部：10字节帧头 + 12字节分片头
+// 中止帧：binOffset 与 binTotal 均为 kFragmentAbort、无消息体与数据，接收方丢弃该流已收到的部分
+// （服务器在转发中途放弃一个流时发给已收到前面分片的接收方，释放其重组状态）
+static const quint32 kFragmentAbort = 0xFFFFFFFFu;
+
+// 消息体编解码（按编码选择 QJsonDocument 或 QCborValue）
+QByteArray encodeBody(const QJsonObject& j, BodyEncoding encoding);
+QJsonObject decodeBody(const QByteArray& body, BodyEncoding encoding);
+
+// 服务器原样转发给同房间其他成员的类型（透传，不修改内容）
+inline bool isRelayType(quint16 type) {
+    return type == MSG_TEXT || type == MSG_DEVICE_DATA ||
+           type == MSG_VIDEO_FRAME || type == MSG_AUDIO_FRAME ||
+           type == MSG_CONTROL;
+}
+
+// 轻量字段读取：只扫描紧凑JSON对象的顶层键值，不构建 QJsonDocument
+// - 用于服务器读取少量字段（roomId/username/user_type/command/target 等）
+// - 找不到、类型不符或字符串含转义时返回 false，调用方可回退到完整解码
+class JsonFieldScanner {
+public:
+    explicit JsonFieldScanner(const QByteArray& json) : json_(json) {}
+    bool contains(const char* key) const;
+    bool string(const char* key, QString& out) const;   // 仅限无转义的字符串值
+    bool integer(const char* key, qint64& out) const;   // 整数（或可精确表示的数字）
+    bool number(const char* key, double& out) const;    // 任意数字
+private:
+    bool find(const char* key, int& begin, int& end) const; // 值在 json_ 中的 [begin, end)
+    QByteArray json_;
+};
+
 // 一条完整消息
+// 零拷贝：bin/jsonBytes 是 block 内部的只读视图（QByteArray::fromRawData），不复制负载；
+// block 与接收缓冲区隐式共享，保证视图在 Packet（及其拷贝）存活期间有效。
+// 需要脱离 Packet 长期保存 bin 时，请先深拷贝：QByteArray(p.bin.constData(), p.bin.size())
+// JSON 延迟解码：只有第一次调用 json() 时才构建 QJsonObject，媒体帧通常永远不会触发
 struct Packet {
-    quint16 type = 0;
-    QJsonObject json;
-    QByteArray bin; // 可为空
+    quint16 type = 0;      // 已去掉编码标记位
+    BodyEncoding encoding = BODY_JSON;
+    QByteArray jsonBytes;  // 原始消息体字节视图（JSON或CBOR，见 encoding；可为空）
+    QByteArray bin;        // 可为空
+    QByteArray block;      // 承载本包的接收块（隐式共享，不拷贝）
+    int frameOffset = 0;   // 本包在 block 中的起始偏移（指向length字段）
+    int frameSize = 0;     // 完整帧字节数（含4B length）
+
+    // 分片帧（见 kTypeFragmentFlag）：bin 为本分片数据，jsonBytes 仅第一个分片非空
+    bool fragment = false;
+    bool reassembled = false;  // 由分片重组得到的完整包（frame() 为等价的完整帧）
+    quint32 streamId = 0;
+    quint32 fragmentOffset = 0;
+    quint32 binTotal = 0;
+    bool fragmentAbort() const { return fragment && fragmentOffset == kFragmentAbort; }
+
+    // 原始帧字节视图 [length][type][jsonSize][json][bin]，同样只在 Packet 存活期间有效
+    QByteArray frame() const {
+        return QByteArray::fromRawData(block.constData() + frameOffset, frameSize);
+    }
+
+    // 完整JSON对象（首次访问时解码并缓存）
+    const QJsonObject& json() const;
+
+    // 常用字段的类型化读取：直接扫描 jsonBytes（JSON或CBOR），必要时回退到 json()
+    QString stringField(const char* key) const;
+    int intField(const char* key, int defaultValue = 0) const;
+    // 数字字段；不存在或不是数字时 ok（可为空）置 false
+    double doubleField(const char* key, bool* ok = nullptr) const;
+    QString roomId() const   { return stringField("roomId"); }
+    QString username() const { return stringField("username"); }
+    int userType() const     { return intField("user_type"); }
+    QString command() const  { return stringField("command"); }
+    QString target() const   { return stringField("target"); }
+
+private:
+    mutable QJsonObject json_;
+    mutable bool jsonDecoded_ = false;
 };
 
 // 工具：JSON编解码（使用紧凑格式，节约带宽）
@@ -45,12 +143,103 @@ inline QJsonObject fromJsonBytes(const QByteArray& b) {
     return doc.isObject() ? doc.object() : QJsonObject{};
 }
 
-// 打包（发送前调用）
+// 打包（发送前调用）：返回连续字节，会把 bin 复制进新缓冲区；大负载请使用 framePacket()
 QByteArray buildPacket(quint16 type,
                        const QJsonObject& json,
-                       const QByteArray& bin = QByteArray());
+                       const QByteArray& bin = QByteArray(),
+                       BodyEncoding encoding = BODY_JSON);
+
+// 分段帧（scatter-gather）：10字节头部 + JSON + bin 三段
+// json/bin 与调用方隐式共享，不复制；配合 writeFramed() 以 iovec 方式发送
+struct FramedPacket {
+    QByteArray header; // [length][type][jsonSize]
+    QByteArray json;
+    QByteArray bin;
+
+    int size() const { return header.size() + json.size() + bin.size(); }
+    QByteArray flatten() const; // 需要连续字节时才拼接（会复制）
+};
+
+FramedPacket framePacket(quint16 type,
+                         const QJsonObject& json,
+                         const QByteArray& bin = QByteArray(),
+                         BodyEncoding encoding = BODY_JSON);
+// body 为已编码的消息体字节（按 encoding 设置帧头标记）
+FramedPacket framePacket(quint16 type,
+                         const QByteArray& body,
+                         const QByteArray& bin,
+                         BodyEncoding encoding = BODY_JSON);
+
+// 把大 bin 切成分片帧，按返回顺序发送
+// 分片的 bin 是原 bin 的视图（fromRawData），全部写出之前调用方需保持 bin 存活
+QVector<FramedPacket> fragmentPacket(quint16 type,
+                                     const QByteArray& body,
+                                     const QByteArray& bin,
+                                     quint32 streamId,
+                                     BodyEncoding encoding = BODY_JSON,
+                                     int fragmentSize = kFragmentSize);
+// 中止一个分片流（见 kFragmentAbort）
+FramedPacket abortFragment(quint16 type, quint32 streamId);
+// 转发分片时改写 stream id：返回新的头部，其余字节（消息体+分片数据）可直接取 frame() 之后的视图
+QByteArray rewriteFragmentHeader(const Packet& fragment, quint32 streamId);
+
+// 按顺序发送若干段字节
+// - QTcpSocket 发送缓冲为空时，直接对描述符做一次 sendmsg（iovec），内核接收的部分不经过Qt缓冲
+// - 其余部分按 QIODevice::write 顺序追加，保证字节顺序
+// 返回写入（或排队）的字节数，出错返回 -1
+qint64 writeSegments(QIODevice* dev, const QByteArray* segs, int count);
+inline qint64 writeFramed(QIODevice* dev, const FramedPacket& f) {
+    const QByteArray segs[3] = { f.header, f.json, f.bin };
+    return writeSegments(dev, segs, 3);
+}
 
 // 拆包（在QTcpSocket::readyRead里，把readAll追加到buffer，然后调用drainPackets）
 // - 解决粘包/半包；只要buffer里有完整包就会解析出来放进out
 // - 返回是否至少解析出1个完整包
+// - 按偏移游标解析，最后只移除一次已消费部分；长连接请优先使用 PacketBuffer
+// - 不重组分片：分片帧按 fragment=true 原样交付（重组由 PacketBuffer 负责）
 bool drainPackets(QByteArray& buffer, QVector<Packet>& out);
+
+// 接收缓冲区（读游标 + 延迟压缩）
+// - append(): 缓冲区无残留时直接共享 readAll() 得到的块，零拷贝
+// - drain():  只移动读游标，不做 remove(0, n) 式的整体搬移
+// - 已消费部分仅在超过阈值时才压缩；若块仍被已产出的 Packet 引用，只复制未消费的尾部
+// - 分片帧按 stream id 重组，最后一个分片到达后交付完整包（reassembled=true）；
+//   服务器在客户端登录协商分片之前关闭重组，未认证的连接不能让服务器分配重组内存
+// - 交付分片时（setDeliverFragments），因出错/淘汰/重新开始而作废的流以一个中止帧（fragmentAbort()）交付，
+//   排在引起作废的分片之前，转发方据此通知下游
+class PacketBuffer {
+public:
+    void append(const QByteArray& chunk);
+    bool drain(QVector<Packet>& out);
+    int size() const { return buf_.size() - rd_; } // 未消费字节数
+    bool isEmpty() const { return size() == 0; }
+    void clear() { buf_.clear(); rd_ = 0; assemblies_.clear(); assemblyBytes_ = 0; }
+
+    // 是否同时交付分片帧本身（服务器用于直通转发）；重组完成的完整包总会交付
+    void setDeliverFragments(bool on) { deliverFragments_ = on; }
+    // 是否重组分片（默认开启）；关闭时分片帧不进入重组，进行中的流被丢弃
+    void setReassemble(bool on);
+
+private:
+    struct Assembly {
+        QByteArray block;    // 重组中的完整帧 [length][type][jsonSize][json][已收到的bin]
+        quint16 type = 0;
+        quint32 binTotal = 0;
+        quint32 received = 0; // 已收到的 bin 字节数（即下一个分片应有的 binOffset）
+        quint64 seq = 0;     // 开始顺序，超过并发上限时淘汰最早的
+    };
+    bool assembleFragments(QVector<Packet>& out, int first);
+    bool assemble(const Packet& fragment, Packet& done);
+    // 丢弃一个重组中的流；notify 为 true 且交付分片时，记下中止帧由 assembleFragments 交付
+    void dropAssembly(QHash<quint32, Assembly>::iterator it, bool notify);
+
+    QByteArray buf_; // [rd_, buf_.size()) 为未消费数据，写偏移即 buf_.size()
+    int rd_ = 0;     // 读游标
+    QHash<quint32, Assembly> assemblies_; // stream id -> 重组状态
+    quint64 assemblySeq_ = 0;
+    quint64 assemblyBytes_ = 0; // 进行中的流声明的 bin 总量
+    QVector<Packet> aborted_;   // 待交付的中止帧
+    bool deliverFragments_ = false;
+    bool reassemble_ = true;
+};
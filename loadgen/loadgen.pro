@@ -0,0 +1,19 @@
+TEMPLATE = app
+TARGET = loadgen
+QT += core network
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+INCLUDEPATH += ../client-factory/src ../server/src
+SOURCES += src/main.cpp \
+           src/participant.cpp \
+           src/loadstats.cpp \
+           ../client-factory/src/clientconn.cpp \
+           ../server/src/recording.cpp \
+           ../server/src/replaysource.cpp
+HEADERS += src/participant.h \
+           src/loadstats.h \
+           ../client-factory/src/clientconn.h \
+           ../server/src/recording.h \
+           ../server/src/replaysource.h
+include(../common/common.pri)
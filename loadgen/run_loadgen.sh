@@ -0,0 +1,7 @@
+#!/usr/bin/env bash
+# 例：./run_loadgen.sh --rooms 10 --participants 4 --fps 15 --video-kb 60 --duration 30
+set -e
+cd "$(dirname "$0")"
+qmake
+make -j
+./loadgen "$@"
@@ -0,0 +1,84 @@
+#include "loadstats.h"
+#include <algorithm>
+#include "../../common/protocol.h"
+
+qint64 loadClockUs()
+{
+    static QElapsedTimer clock;
+    if (!clock.isValid()) clock.start();
+    return clock.nsecsElapsed() / 1000;
+}
+
+void LoadStats::onSent(quint16 type, int bytes)
+{
+    TypeStats& t = types_[type];
+    ++t.sent;
+    t.sentBytes += quint64(bytes);
+}
+
+void LoadStats::onReceived(quint16 type, int bytes, qint64 latencyUs)
+{
+    TypeStats& t = types_[type];
+    ++t.received;
+    t.receivedBytes += quint64(bytes);
+    if (latencyUs >= 0) t.latencyUs.append(latencyUs);
+}
+
+void LoadStats::onDropped(quint16 type, qint64 count)
+{
+    types_[type].dropped += quint64(count);
+}
+
+quint64 LoadStats::totalReceived() const
+{
+    quint64 n = 0;
+    for (const TypeStats& t : types_) n += t.received;
+    return n;
+}
+
+static QString typeName(quint16 type)
+{
+    switch (type) {
+    case MSG_TEXT:        return "text";
+    case MSG_DEVICE_DATA: return "device";
+    case MSG_VIDEO_FRAME: return "video";
+    case MSG_AUDIO_FRAME: return "audio";
+    case MSG_CONTROL:     return "control";
+    default:              return QString("type%1").arg(type);
+    }
+}
+
+// 已排序样本的分位数（毫秒）
+static double percentileMs(const QVector<qint64>& sorted, double q)
+{
+    if (sorted.isEmpty()) return 0.0;
+    const int idx = qBound(0, int(q * (sorted.size() - 1) + 0.5), sorted.size() - 1);
+    return sorted.at(idx) / 1000.0;
+}
+
+void LoadStats::report(QTextStream& out, double seconds) const
+{
+    const double secs = qMax(seconds, 0.001);
+    out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10\n")
+           .arg("type", -8).arg("sent", 9).arg("recv", 9).arg("drops", 7)
+           .arg("rx pkt/s", 10).arg("rx MB/s", 9)
+           .arg("p50 ms", 8).arg("p90 ms", 8).arg("p99 ms", 8).arg("max ms", 8);
+    for (auto it = types_.constBegin(); it != types_.constEnd(); ++it) {
+        const TypeStats& t = it.value();
+        QVector<qint64> lat = t.latencyUs;
+        std::sort(lat.begin(), lat.end());
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10\n")
+               .arg(typeName(it.key()), -8)
+               .arg(t.sent, 9)
+               .arg(t.received, 9)
+               .arg(t.dropped, 7)
+               .arg(t.received / secs, 10, 'f', 1)
+               .arg(t.receivedBytes / secs / (1024.0 * 1024.0), 9, 'f', 2)
+               .arg(percentileMs(lat, 0.50), 8, 'f', 2)
+               .arg(percentileMs(lat, 0.90), 8, 'f', 2)
+               .arg(percentileMs(lat, 0.99), 8, 'f', 2)
+               .arg(lat.isEmpty() ? 0.0 : lat.last() / 1000.0, 8, 'f', 2);
+    }
+    out << "errors: " << errors_ << "\n";
+    out.flush();
+}
@@ -0,0 +1,37 @@
+#pragma once
+// ===============================================
+// loadgen/src/loadstats.h
+// 压测统计：按消息类型汇总发送/接收/丢失数、负载(bin)吞吐与端到端延迟分位数
+// 发送方把进程内单调时钟写入JSON的 "lgts"（微秒），接收方直接相减得到延迟，
+// 因此只在同一个 loadgen 进程内的收发之间有效。
+// ===============================================
+#include <QtCore>
+
+// 进程内单调时钟（微秒）
+qint64 loadClockUs();
+
+class LoadStats
+{
+public:
+    void onSent(quint16 type, int bytes);
+    void onReceived(quint16 type, int bytes, qint64 latencyUs);
+    void onDropped(quint16 type, qint64 count);
+    void onError() { ++errors_; }
+
+    quint64 totalReceived() const;
+
+    // 打印汇总：seconds 为统计窗口长度
+    void report(QTextStream& out, double seconds) const;
+
+private:
+    struct TypeStats {
+        quint64 sent = 0;
+        quint64 sentBytes = 0;
+        quint64 received = 0;
+        quint64 receivedBytes = 0;
+        quint64 dropped = 0;
+        QVector<qint64> latencyUs;
+    };
+    QMap<quint16, TypeStats> types_;
+    quint64 errors_ = 0;
+};
@@ -0,0 +1,144 @@
+#include <QtCore>
+#include "participant.h"
+#include "loadstats.h"
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+// 读取进程累计CPU时间（秒，用户态+内核态），用于计算服务器每核转发包数；不支持时返回 -1
+static double processCpuSeconds(qint64 pid)
+{
+#ifdef Q_OS_LINUX
+    QFile f(QString("/proc/%1/stat").arg(pid));
+    if (!f.open(QIODevice::ReadOnly)) return -1;
+    const QByteArray stat = f.readAll();
+    // 第2个字段（进程名）可能含空格，从最后一个 ')' 之后开始数：state 为第3个字段
+    const QList<QByteArray> fields = stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 13) return -1;
+    const double ticks = double(sysconf(_SC_CLK_TCK));
+    return (fields.at(11).toDouble() + fields.at(12).toDouble()) / ticks; // utime + stime
+#else
+    Q_UNUSED(pid);
+    return -1;
+#endif
+}
+
+// 无界面压测工具：模拟 N 个房间 × M 个参与者
+// 每个房间前 --cameras 个参与者为工厂端摄像头（视频+音频+设备数据），其余为专家端观看者
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Remote Expert load generator");
+    parser.addHelpOption();
+
+    QCommandLineOption hostOpt("host", "Server host", "host", "127.0.0.1");
+    QCommandLineOption portOpt(QStringList() << "p" << "port", "Server port", "port", "9000");
+    QCommandLineOption roomsOpt("rooms", "Number of rooms", "n", "4");
+    QCommandLineOption partOpt("participants", "Participants per room", "m", "3");
+    QCommandLineOption camOpt("cameras", "Camera (factory) participants per room", "k", "1");
+    QCommandLineOption fpsOpt("fps", "Video frames per second per camera", "fps", "15");
+    QCommandLineOption sizeOpt("video-kb", "JPEG frame size in KB", "kb", "60");
+    QCommandLineOption devOpt("device-hz", "Device data samples per second per camera", "hz", "10");
+    QCommandLineOption viewerAudioOpt("viewer-audio", "Viewers also send 20ms PCM audio");
+    QCommandLineOption noAudioOpt("no-audio", "Cameras do not send audio");
+    QCommandLineOption durOpt("duration", "Measurement duration in seconds", "s", "30");
+    QCommandLineOption rampOpt("ramp-ms", "Delay between connection attempts", "ms", "5");
+    QCommandLineOption jsonOpt("json", "Do not negotiate CBOR bodies");
+    QCommandLineOption prefixOpt("user-prefix", "Username prefix", "prefix", "lg");
+    QCommandLineOption replayOpt("replay", "Cameras replay this recording (<record-dir>/<ticket>) instead of synthetic streams", "dir");
+    QCommandLineOption replaySpeedOpt("replay-speed", "Replay speed (1-16)", "x", "1");
+    QCommandLineOption pidOpt("server-pid", "Server process id (report server CPU and packets/s per core, Linux)", "pid");
+    parser.addOptions({hostOpt, portOpt, roomsOpt, partOpt, camOpt, fpsOpt, sizeOpt, devOpt,
+                       viewerAudioOpt, noAudioOpt, durOpt, rampOpt, jsonOpt, prefixOpt, pidOpt,
+                       replayOpt, replaySpeedOpt});
+    parser.process(app);
+
+    const QString host = parser.value(hostOpt);
+    const quint16 port = parser.value(portOpt).toUShort();
+    const int rooms = qMax(1, parser.value(roomsOpt).toInt());
+    const int perRoom = qMax(1, parser.value(partOpt).toInt());
+    const int cameras = qBound(0, parser.value(camOpt).toInt(), perRoom);
+    const int durationSec = qMax(1, parser.value(durOpt).toInt());
+    const int rampMs = qMax(0, parser.value(rampOpt).toInt());
+
+    LoadStats stats;
+    QList<Participant*> all;
+    int joinedCount = 0;
+    const int total = rooms * perRoom;
+    QTextStream out(stdout);
+
+    for (int r = 0; r < rooms; ++r) {
+        for (int i = 0; i < perRoom; ++i) {
+            ParticipantConfig cfg;
+            cfg.sourceId = r * perRoom + i;
+            cfg.camera = i < cameras;
+            cfg.userType = cfg.camera ? 1 : 2;
+            cfg.user = QString("%1-r%2-%3%4").arg(parser.value(prefixOpt)).arg(r)
+                       .arg(cfg.camera ? "cam" : "view").arg(i);
+            cfg.roomId = QString("%1-room-%2").arg(parser.value(prefixOpt)).arg(r);
+            cfg.sendAudio = cfg.camera ? !parser.isSet(noAudioOpt) : parser.isSet(viewerAudioOpt);
+            cfg.fps = parser.value(fpsOpt).toInt();
+            cfg.videoBytes = parser.value(sizeOpt).toInt() * 1024;
+            cfg.deviceHz = parser.value(devOpt).toInt();
+            cfg.preferCbor = !parser.isSet(jsonOpt);
+            cfg.replayDir = parser.value(replayOpt);
+            cfg.replaySpeed = parser.value(replaySpeedOpt).toDouble();
+
+            auto* p = new Participant(cfg, &stats, &app);
+            QObject::connect(p, &Participant::failed, [&out](const QString& why) {
+                out << "[loadgen] " << why << "\n";
+                out.flush();
+            });
+            QObject::connect(p, &Participant::joined, [&]() {
+                if (++joinedCount == total) {
+                    out << "[loadgen] all " << total << " participants joined\n";
+                    out.flush();
+                }
+            });
+            all.append(p);
+            QTimer::singleShot(rampMs * (r * perRoom + i), p, [p, host, port]() {
+                p->start(host, port);
+            });
+        }
+    }
+
+    // 统计窗口：从全部连接发起后开始计时，到时停止发送并留出1秒排空在途数据
+    const qint64 startUs = loadClockUs() + qint64(rampMs) * total * 1000;
+    // 服务器CPU：与统计窗口同时开始采样
+    const qint64 serverPid = parser.value(pidOpt).toLongLong();
+    double serverCpuStart = -1;
+    if (serverPid > 0) {
+        QTimer::singleShot(rampMs * total, &app, [&]() {
+            serverCpuStart = processCpuSeconds(serverPid);
+        });
+    }
+    QTimer::singleShot(rampMs * total + durationSec * 1000, &app, [&]() {
+        for (Participant* p : all) p->stopStreaming();
+        QTimer::singleShot(1000, &app, [&]() {
+            const double secs = (loadClockUs() - startUs) / 1e6;
+            out << "[loadgen] rooms=" << rooms << " participants/room=" << perRoom
+                << " joined=" << joinedCount << "/" << total
+                << " window=" << QString::number(secs, 'f', 1) << "s\n";
+            stats.report(out, secs);
+            if (serverPid > 0) {
+                const double cpuEnd = processCpuSeconds(serverPid);
+                if (serverCpuStart < 0 || cpuEnd < 0) {
+                    out << "[loadgen] cannot read CPU time of pid " << serverPid << "\n";
+                } else {
+                    // 接收方收到的包即服务器转发出的包；按服务器消耗的CPU秒数折算为单核吞吐
+                    const double cpu = qMax(cpuEnd - serverCpuStart, 0.001);
+                    out << "server cpu: " << QString::number(cpu, 'f', 2) << "s ("
+                        << QString::number(100.0 * cpu / secs, 'f', 0) << "% of one core), "
+                        << "forwarded pkt/s per core: "
+                        << QString::number(stats.totalReceived() / cpu, 'f', 0) << "\n";
+                }
+                out.flush();
+            }
+            app.quit();
+        });
+    });
+
+    return app.exec();
+}
@@ -0,0 +1,191 @@
+#include "participant.h"
+#include "replaysource.h"
+
+// 20ms @ 16kHz mono S16LE
+static const int kAudioFrameBytes = 16000 / 50 * 2;
+
+static QByteArray syntheticJpeg(int size)
+{
+    // SOI ... EOI，中间填充伪随机字节（不可压缩，接近真实JPEG）
+    QByteArray b(qMax(size, 4), Qt::Uninitialized);
+    quint32 x = 2463534242u;
+    for (int i = 0; i < b.size(); ++i) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        b[i] = char(x & 0xff);
+    }
+    b[0] = char(0xFF); b[1] = char(0xD8);
+    b[b.size() - 2] = char(0xFF); b[b.size() - 1] = char(0xD9);
+    return b;
+}
+
+Participant::Participant(const ParticipantConfig& cfg, LoadStats* stats, QObject* parent)
+    : QObject(parent), cfg_(cfg), stats_(stats)
+{
+    conn_.setPreferCbor(cfg_.preferCbor);
+    conn_.setAutoReconnect(false); // 断线计为错误，不自动恢复
+    connect(&conn_, &ClientConn::connected, this, &Participant::onConnected);
+    connect(&conn_, &ClientConn::disconnected, this, &Participant::onDisconnected);
+    connect(&conn_, &ClientConn::packetArrived, this, &Participant::onPkt);
+
+    videoTimer_.setTimerType(Qt::PreciseTimer);
+    audioTimer_.setTimerType(Qt::PreciseTimer);
+    connect(&videoTimer_, &QTimer::timeout, this, &Participant::sendVideo);
+    connect(&audioTimer_, &QTimer::timeout, this, &Participant::sendAudio);
+    connect(&deviceTimer_, &QTimer::timeout, this, &Participant::sendDevice);
+
+    if (cfg_.camera) jpeg_ = syntheticJpeg(cfg_.videoBytes);
+    pcm_ = QByteArray(kAudioFrameBytes, '\0');
+}
+
+void Participant::start(const QString& host, quint16 port)
+{
+    conn_.connectTo(host, port);
+}
+
+void Participant::onConnected()
+{
+    state_ = Registering;
+    conn_.send(MSG_REGISTER, QJsonObject{{"username", cfg_.user},
+                                         {"password", cfg_.password},
+                                         {"email", ""}, {"phone", ""},
+                                         {"user_type", cfg_.userType}});
+}
+
+void Participant::onDisconnected()
+{
+    if (state_ != Stopped) {
+        stats_->onError();
+        emit failed(QString("%1 disconnected").arg(cfg_.user));
+    }
+    stopStreaming();
+}
+
+void Participant::onPkt(Packet p)
+{
+    if (p.type == MSG_SERVER_EVENT) {
+        const int code = p.intField("code", -1);
+        switch (state_) {
+        case Registering:
+            // 0=新注册，409=已存在（重复运行），都继续登录
+            state_ = LoggingIn;
+            conn_.send(MSG_LOGIN, QJsonObject{{"username", cfg_.user},
+                                              {"password", cfg_.password},
+                                              {"user_type", cfg_.userType}});
+            break;
+        case LoggingIn:
+            if (code != 0) {
+                stats_->onError();
+                emit failed(QString("%1 login failed: %2").arg(cfg_.user, p.stringField("message")));
+                return;
+            }
+            state_ = Joining;
+            conn_.send(MSG_JOIN_WORKORDER, QJsonObject{{"roomId", cfg_.roomId}});
+            break;
+        case Joining:
+            if (code != 0) {
+                stats_->onError();
+                emit failed(QString("%1 join failed: %2").arg(cfg_.user, p.stringField("message")));
+                return;
+            }
+            startStreaming();
+            emit joined();
+            break;
+        default:
+            if (code != 0) stats_->onError();
+            break;
+        }
+        return;
+    }
+
+    // 媒体/数据帧：端到端延迟 + 丢帧检测
+    const qint64 sentUs = qint64(p.json().value("lgts").toDouble(-1));
+    const qint64 latency = sentUs >= 0 ? loadClockUs() - sentUs : -1;
+    stats_->onReceived(p.type, p.bin.size(), latency);
+
+    const qint64 seq = qint64(p.json().value("seq").toDouble(-1));
+    const int src = p.json().value("src").toInt(-1);
+    if (seq >= 0 && src >= 0) {
+        const quint64 key = (quint64(src) << 16) | p.type;
+        auto it = expectedSeq_.find(key);
+        if (it != expectedSeq_.end() && seq > it.value())
+            stats_->onDropped(p.type, seq - it.value());
+        if (it == expectedSeq_.end() || seq >= it.value())
+            expectedSeq_[key] = seq + 1;
+    }
+}
+
+void Participant::startStreaming()
+{
+    state_ = Streaming;
+    if (cfg_.camera && !cfg_.replayDir.isEmpty()) {
+        // 每个摄像头从录制中的不同位置开始（按 sourceId 错开），结果可复现
+        replay_ = new ReplaySource(this);
+        if (!replay_->open(cfg_.replayDir)) {
+            emit failed(QString("%1: cannot open recording: %2").arg(cfg_.user, replay_->errorString()));
+            return;
+        }
+        connect(replay_, &ReplaySource::packet, this, &Participant::sendRecorded);
+        replay_->setLoop(true);
+        replay_->setSpeed(cfg_.replaySpeed);
+        if (replay_->durationMs() > 0)
+            replay_->seek(qint64(cfg_.sourceId) * 7919 % replay_->durationMs());
+        replay_->start();
+        return;
+    }
+    if (cfg_.camera) {
+        if (cfg_.fps > 0) videoTimer_.start(1000 / cfg_.fps);
+        if (cfg_.deviceHz > 0) deviceTimer_.start(qMax(1, 1000 / cfg_.deviceHz));
+    }
+    if (cfg_.sendAudio) audioTimer_.start(20);
+}
+
+void Participant::stopStreaming()
+{
+    videoTimer_.stop();
+    audioTimer_.stop();
+    deviceTimer_.stop();
+    if (replay_) replay_->pause();
+    if (state_ == Streaming) state_ = Stopped;
+}
+
+void Participant::sendMedia(quint16 type, QJsonObject j, const QByteArray& bin)
+{
+    j.insert("roomId", cfg_.roomId);
+    j.insert("src", cfg_.sourceId);
+    j.insert("seq", double(nextSeq_[type]++));
+    j.insert("lgts", double(loadClockUs()));
+    conn_.send(type, j, bin);
+    stats_->onSent(type, bin.size());
+}
+
+void Participant::sendVideo()
+{
+    sendMedia(MSG_VIDEO_FRAME, QJsonObject{{"codec", "jpeg"}}, jpeg_);
+}
+
+void Participant::sendAudio()
+{
+    sendMedia(MSG_AUDIO_FRAME, QJsonObject{{"codec", "pcm_s16le"}, {"rate", 16000}}, pcm_);
+}
+
+// 回放的帧：取原消息体与负载，按本参与者重新打上 src/seq/lgts（统计延迟与丢帧）
+void Participant::sendRecorded(quint16, const QByteArray& frame)
+{
+    PacketBuffer parser;
+    parser.append(QByteArray(frame.constData(), frame.size()));
+    QVector<Packet> pkts;
+    if (!parser.drain(pkts)) return;
+    for (const Packet& p : pkts)
+        sendMedia(p.type, p.json(), QByteArray(p.bin.constData(), p.bin.size()));
+}
+
+void Participant::sendDevice()
+{
+    static const char* kMetrics[] = {"spindle_temp", "vibration", "current"};
+    const qint64 n = nextSeq_.value(MSG_DEVICE_DATA);
+    sendMedia(MSG_DEVICE_DATA,
+              QJsonObject{{"deviceId", QString("CNC-%1").arg(cfg_.sourceId)},
+                          {"type", kMetrics[n % 3]},
+                          {"value", 60.0 + (n % 100) * 0.137}},
+              QByteArray());
+}
@@ -0,0 +1,74 @@
+#pragma once
+// ===============================================
+// loadgen/src/participant.h
+// 一个模拟参与者：注册 -> 登录 -> 加入工单，然后按配置发送合成媒体流
+// - 摄像头（工厂端）：JPEG视频帧 + 20ms PCM音频 + 设备数据
+// - 观看者（专家端）：默认只接收，可选发送语音
+// 收到的帧按 "lgts" 计算端到端延迟，按 (来源, 类型) 的 "seq" 空洞统计丢帧
+// 指定 replayDir 时摄像头不发合成流，而是按原始时间间隔循环回放一段录制（见 ReplaySource）
+// ===============================================
+#include <QtCore>
+#include "clientconn.h"
+#include "loadstats.h"
+
+class ReplaySource;
+
+struct ParticipantConfig
+{
+    QString user;
+    QString password = "loadgen";
+    QString roomId;
+    int userType = 1;        // 1=工厂端 2=专家端
+    int sourceId = 0;        // 全局唯一，写入 "src" 用于丢帧统计
+    bool camera = false;     // 是否发送视频和设备数据
+    bool sendAudio = false;
+    int fps = 15;
+    int videoBytes = 60 * 1024;
+    int deviceHz = 10;
+    bool preferCbor = true;
+    QString replayDir;       // 录制目录（<record-dir>/<ticket>），为空则发送合成流
+    double replaySpeed = 1.0;
+};
+
+class Participant : public QObject
+{
+    Q_OBJECT
+public:
+    Participant(const ParticipantConfig& cfg, LoadStats* stats, QObject* parent = nullptr);
+    void start(const QString& host, quint16 port);
+    void stopStreaming();
+    bool isStreaming() const { return state_ == Streaming; }
+
+signals:
+    void joined();
+    void failed(const QString& reason);
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onPkt(Packet p);
+    void sendVideo();
+    void sendAudio();
+    void sendDevice();
+    void sendRecorded(quint16 type, const QByteArray& frame);
+
+private:
+    enum State { Idle, Registering, LoggingIn, Joining, Streaming, Stopped };
+
+    void sendMedia(quint16 type, QJsonObject j, const QByteArray& bin);
+    void startStreaming();
+
+    ParticipantConfig cfg_;
+    LoadStats* stats_;
+    ClientConn conn_;
+    State state_ = Idle;
+
+    QTimer videoTimer_;
+    QTimer audioTimer_;
+    QTimer deviceTimer_;
+    QByteArray jpeg_;   // 合成JPEG（每帧共享同一缓冲，不复制）
+    QByteArray pcm_;    // 20ms 16kHz 单声道 S16LE
+    ReplaySource* replay_ = nullptr;
+    QHash<quint16, qint64> nextSeq_;     // 发送序号（按类型）
+    QHash<quint64, qint64> expectedSeq_; // 接收：(src<<16|type) -> 期望的下一个序号
+};
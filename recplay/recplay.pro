@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = recplay
+QT += core
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
+INCLUDEPATH += ../server/src
+SOURCES += src/main.cpp \
+           ../server/src/recording.cpp
+HEADERS += ../server/src/recording.h
+include(../common/common.pri)
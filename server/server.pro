@@ -5,7 +5,41 @@ CONFIG += c++11 console
 CONFIG -= app_bundle
 SOURCES += src/main.cpp \
            src/databasemanager.cpp \
-           src/roomhub.cpp
+           src/usercache.cpp \
+           src/sessionstore.cpp \
+           src/roomhub.cpp \
+           src/hubserver.cpp \
+           src/egressqueue.cpp \
+           src/logging.cpp \
+           src/transport.cpp \
+           src/qttransport.cpp \
+           src/dbworker.cpp \
+           src/recorder.cpp \
+           src/recording.cpp \
+           src/replaysource.cpp \
+           src/timeseries.cpp
 HEADERS += src/roomhub.h \
-    src/databasemanager.h
+    src/databasemanager.h \
+    src/usercache.h \
+    src/sessionstore.h \
+    src/roomdirectory.h \
+    src/slabpool.h \
+    src/spscqueue.h \
+    src/hubserver.h \
+    src/egressqueue.h \
+    src/logging.h \
+    src/transport.h \
+    src/qttransport.h \
+    src/dbworker.h \
+    src/recorder.h \
+    src/recording.h \
+    src/replaysource.h \
+    src/timeseries.h
+# epoll 传输层仅在 Linux 上编译（--transport epoll）
+linux {
+    SOURCES += src/epolltransport.cpp
+    HEADERS += src/epolltransport.h
+}
+# release 构建编译掉 qCDebug（热路径调试日志零开销）
+CONFIG(release, debug|release): DEFINES += QT_NO_DEBUG_OUTPUT
 include(../common/common.pri)
@@ -1,4 +1,47 @@
 ﻿#include "databasemanager.h"
+#include "logging.h"
+
+// 数据库迁移：第 i 项把 PRAGMA user_version 从 i 升到 i+1，每一步在一个事务内执行
+// 只能追加新步骤，不能修改已发布的步骤
+static const QVector<QStringList>& migrations()
+{
+    static const QVector<QStringList> steps {
+        // 1：初始表结构（早期版本直接建表、user_version 为 0，IF NOT EXISTS 兼容已有数据库）
+        {
+            R"(
+            CREATE TABLE IF NOT EXISTS users (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            username TEXT UNIQUE NOT NULL,
+            password_hash TEXT NOT NULL,
+            email TEXT,
+            phone TEXT,
+            user_type INTEGER NOT NULL,
+            created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+            )
+            )",
+            R"(
+            CREATE TABLE IF NOT EXISTS work_orders(
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            ticket_id TEXT UNIQUE NOT NULL,
+            creator_id INTEGER NOT NULL,
+            status TEXT DEFAULT 'open',
+            created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
+            closed_at DATETIME,
+            FOREIGN KEY (creator_id) REFERENCES users (id)
+            )
+            )"
+        },
+        // 2：索引
+        // - 登录查询按 (username, user_type) 过滤并只取 password_hash：覆盖索引，不回表
+        // - 工单按创建人、按状态查询
+        {
+            "CREATE INDEX IF NOT EXISTS idx_users_login ON users (username, user_type, password_hash)",
+            "CREATE INDEX IF NOT EXISTS idx_work_orders_creator ON work_orders (creator_id)",
+            "CREATE INDEX IF NOT EXISTS idx_work_orders_status ON work_orders (status)"
+        }
+    };
+    return steps;
+}
 
 DatabaseManager& DatabaseManager::instance()
 {
@@ -24,154 +67,231 @@ DatabaseManager::DatabaseManager(QObject *parent) : QObject(parent)
     {
         dbDir.mkpath(".");
     }
-    QString dbPath = dbDir.filePath("remote_support.db");
-    db_.setDatabaseName(dbPath);
-    qInfo()<<"[DB] Database path:"<<dbPath;
+    setDatabasePath(dbDir.filePath("remote_support.db"));
 }
 
-DatabaseManager::~DatabaseManager()
+void DatabaseManager::setDatabasePath(const QString &path)
 {
-    if(db_.isOpen())
+    db_.setDatabaseName(path);
+    qCInfo(lcDb)<<"[DB] Database path:"<<path;
+}
+
+// 所有数据库访问都经由 DbWorker 在 DB 线程执行（DatabaseManager 在该线程构造），只有这一个连接
+QSqlDatabase DatabaseManager::connection()
+{
+    Q_ASSERT_X(QThread::currentThread() == thread(), "DatabaseManager::connection",
+               "database accessed outside the DB thread; use DbWorker");
+    return db_;
+}
+
+// 每个连接的设置：WAL 下读写互不阻塞；synchronous=NORMAL 只在检查点时 fsync，
+// 掉电最多丢失最近提交的事务，数据库不会损坏
+bool DatabaseManager::configure(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if(!query.exec("PRAGMA journal_mode=WAL") || !query.next()
+            || query.value(0).toString().compare("wal", Qt::CaseInsensitive) != 0)
     {
-        db_.close();
-        qInfo()<<"[DB] Database closed.";
+        qCWarning(lcDb)<<"[DB] WAL not enabled:"<<query.lastError().text();
+    }
+    if(!query.exec("PRAGMA synchronous=NORMAL"))
+    {
+        qCWarning(lcDb)<<"[DB] Set synchronous failed:"<<query.lastError().text();
+        return false;
     }
+    return true;
 }
 
-bool DatabaseManager::initialize()
+// 按 user_version 执行尚未执行的迁移步骤
+bool DatabaseManager::migrate()
 {
-        if(!db_.open())
+    QSqlQuery query(db_);
+    if(!query.exec("PRAGMA user_version") || !query.next())
+    {
+        qCCritical(lcDb)<<"[DB] Read schema version failed:"<<query.lastError().text();
+        return false;
+    }
+    const int current = query.value(0).toInt();
+    query.finish();
+
+    const QVector<QStringList>& steps = migrations();
+    for(int version = current; version < steps.size(); ++version)
+    {
+        db_.transaction();
+        for(const QString& sql : steps.at(version))
         {
-            qCritical()<<"[DB] Failed to open database:"<<db_.lastError().text();
+            if(!query.exec(sql))
+            {
+                qCCritical(lcDb)<<"[DB] Migration"<<version + 1<<"failed:"<<query.lastError().text();
+                db_.rollback();
+                return false;
+            }
         }
+        // PRAGMA 不支持绑定参数
+        if(!query.exec(QString("PRAGMA user_version = %1").arg(version + 1)) || !db_.commit())
+        {
+            qCCritical(lcDb)<<"[DB] Migration"<<version + 1<<"commit failed:"<<db_.lastError().text();
+            db_.rollback();
+            return false;
+        }
+        qCInfo(lcDb)<<"[DB] Schema migrated to version"<<version + 1;
+    }
+    return true;
+}
 
-        QSqlQuery query(db_);
-
-    QString createUserTable = R"(
-                              CREATE TABLE IF NOT EXISTS users (
-                              id INTEGER PRIMARY KEY AUTOINCREMENT,
-                              username TEXT UNIQUE NOT NULL,
-                              password_hash TEXT NOT NULL,
-                              email TEXT,
-                              phone TEXT,
-                              user_type INTEGER NOT NULL,
-                              created_at DATETIME DEFAULT CURRENT_TIMESTAMP
-                              )
-                              )";
+DatabaseManager::~DatabaseManager()
+{
+    // 先释放本线程缓存的语句，再关闭连接
+    statements_.setLocalData(nullptr);
+    if(db_.isOpen())
+    {
+        db_.close();
+        qCInfo(lcDb)<<"[DB] Database closed.";
+    }
+}
 
-    if(!query.exec(createUserTable))
+bool DatabaseManager::initialize()
+{
+    if(db_.isOpen())
     {
-        qCritical()<<"Failed to create users table:"<<query.lastError().text();
+        return true;
+    }
+    db_.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+    if(!db_.open())
+    {
+        qCCritical(lcDb)<<"[DB] Failed to open database:"<<db_.lastError().text();
         return false;
     }
-
-    QString createWorkOrderTable = R"(
-                                   CREATE TABLE IF NOT EXISTS work_orders(
-                                   id INTEGER PRIMARY KEY AUTOINCREMENT,
-                                   ticket_id TEXT UNIQUE NOT NULL,
-                                   creator_id INTEGER NOT NULL,
-                                   status TEXT DEFAULT 'open',
-                                   created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
-                                   closed_at DATETIME,
-                                   FOREIGN KEY (creator_id) REFERENCES users (id)
-                                   )
-                                   )";
-    if(!query.exec(createWorkOrderTable))
-    {
-        qCritical()<<"Failed to create work_orders table:"<<query.lastError().text();
+    if(!configure(db_) || !migrate())
+    {
         return false;
     }
-    qInfo() << "Database initialized successfully! Tables (users/work_orders) are ready.";
+    qCInfo(lcDb) << "Database initialized successfully! Tables (users/work_orders) are ready.";
     return true;
 }
 
-
-bool DatabaseManager::validateUser(const QString &username, const QString &password,int userType)
+// 热点查询的预编译语句，每个线程（连接）准备一次后反复绑定执行
+DatabaseManager::Statements* DatabaseManager::statements(const QSqlDatabase &db)
 {
-    if(!db_.isOpen())
+    if(!statements_.hasLocalData())
     {
-        qCritical() << "[DB] Validate user failed: Database is NOT open!";
-        return false;
+        auto* st = new Statements(db);
+        // 按用户名取整条记录（缓存用），user_type 在内存中比较；idx_users_login 覆盖本查询
+        st->lookup.setForwardOnly(true);
+        st->lookup.prepare(R"(SELECT id, user_type, password_hash FROM users WHERE username = :username)");
+        st->exists.setForwardOnly(true);
+        st->exists.prepare("SELECT id FROM users WHERE username = :username");
+        // 用户名已存在时由 UNIQUE 约束忽略插入，省去单独的 userExists 查询
+        st->insert.prepare(R"(
+                  INSERT OR IGNORE INTO users (username,password_hash,email,phone,user_type)
+                  VALUES(:username,:password_hash,:email,:phone,:user_type)
+                  )");
+        statements_.setLocalData(st);
     }
+    return statements_.localData();
+}
 
-    QSqlQuery query(db_);
-    query.prepare(R"(SELECT password_hash FROM users WHERE username = :username AND user_type = :user_type)");
+
+// 从数据库读取一个用户记录；不存在或查询失败时返回 false
+bool DatabaseManager::loadUser(const QSqlDatabase &db, const QString &username, UserRecord *out)
+{
+    QSqlQuery& query = statements(db)->lookup;
     query.bindValue(":username",username);
-    query.bindValue(":user_type",userType);
 
     if(!query.exec())
     {
-        qCritical() << "[DB] Query user failed:" << query.lastError().text();
+        qCCritical(lcDb) << "[DB] Query user failed:" << query.lastError().text();
         return false;
     }
     if(!query.next())
     {
-        qWarning() << "[DB] User not found: " << username;
+        query.finish();
+        return false;
+    }
+    out->id = query.value(0).toInt();
+    out->userType = query.value(1).toInt();
+    out->passwordHash = query.value(2).toString();
+    query.finish(); // 结束读事务，语句留待下次绑定
+    return true;
+}
+
+bool DatabaseManager::validateUser(const QString &username, const QString &password,int userType)
+{
+    UserRecord user;
+    if(!userCache_.lookup(username, &user))
+    {
+        QSqlDatabase db = connection();
+        if(!db.isOpen())
+        {
+            qCCritical(lcDb) << "[DB] Validate user failed: Database is NOT open!";
+            return false;
+        }
+        if(!loadUser(db, username, &user))
+        {
+            qCDebug(lcDb) << "[DB] User not found: " << username;
+            return false;
+        }
+        userCache_.insert(username, user);
+    }
+    if(user.userType != userType)
+    {
+        qCDebug(lcDb) << "[DB] User not found: " << username << "with type" << userType;
         return false;
     }
 
-    QString storeHash =query.value(0).toString();
-    qDebug()<< "[DB] Stored hash for" <<username<<":"<<storeHash;
+    QString storeHash = user.passwordHash;
 
     QByteArray inputPasswordBytes = password.toUtf8();
     QByteArray inputHashBytes = QCryptographicHash::hash(inputPasswordBytes,QCryptographicHash::Sha256);
     QString inputHash = inputHashBytes.toHex();
-    qDebug()<<"[DB] Input password hash:"<<inputHash;
 
     bool isPasswordCorrect = (storeHash == inputHash);
     if(isPasswordCorrect)
     {
-        qInfo()<<"[DB] User validate SUCCESS: "<<username;
+        qCDebug(lcDb)<<"[DB] User validate SUCCESS: "<<username;
     }
     else
     {
-        qWarning()<<"[DB] User validate FAILED: Wrong password for"<<username;
+        qCDebug(lcDb)<<"[DB] User validate FAILED: Wrong password for"<<username;
     }
     return isPasswordCorrect;
 }
 
 bool DatabaseManager::userExists(const QString &username)
 {
-    if(!db_.open())
+    QSqlDatabase db = connection();
+    if(!db.isOpen())
     {
-        qCritical()<<"[DB] Check user existence failed: Database not open!";
+        qCCritical(lcDb)<<"[DB] Check user existence failed: Database not open!";
         return false;
     }
-    QSqlQuery query(db_);
-    query.prepare("SELECT id FROM users WHERE username = :username");
+    QSqlQuery& query = statements(db)->exists;
     query.bindValue(":username",username);
 
     if(!query.exec())
     {
-        qCritical()<<"[DB] Check user existence query failed:"<<query.lastError().text();
+        qCCritical(lcDb)<<"[DB] Check user existence query failed:"<<query.lastError().text();
         return false;
     }
 
     bool exists = query.next();
-    qInfo()<<"[DB] User"<<username<<"exists:"<<exists;
+    query.finish();
+    qCDebug(lcDb)<<"[DB] User"<<username<<"exists:"<<exists;
     return exists;
 }
 
 bool DatabaseManager::addUser(const QString &username, const QString &password, const QString &email, const QString &phone, int userType)
 {
-    if(!db_.open())
-    {
-        qCritical()<<"[DB] Add user failed: Database not open!";
-        return false;
-    }
-    if(userExists(username))
+    QSqlDatabase db = connection();
+    if(!db.isOpen())
     {
-        qWarning()<<"[DB] Add user failed: Username already exists ~"<<username;
+        qCCritical(lcDb)<<"[DB] Add user failed: Database not open!";
         return false;
     }
     QByteArray passwordHash = QCryptographicHash::hash(password.toUtf8(),QCryptographicHash::Sha256);
     QString hashStr = passwordHash.toHex();
 
-    QSqlQuery query(db_);
-    query.prepare(R"(
-                  INSERT INTO users (username,password_hash,email,phone,user_type)
-                  VALUES(:username,:password_hash,:email,:phone,:user_type)
-                  )");
+    QSqlQuery& query = statements(db)->insert;
     query.bindValue(":username",username);
     query.bindValue(":password_hash", hashStr);
     query.bindValue(":email", email);
@@ -180,9 +300,52 @@ bool DatabaseManager::addUser(const QString &username, const QString &password,
 
     if(!query.exec())
     {
-        qCritical()<<"[DB] Add user failed:"<<query.lastError().text();
+        qCCritical(lcDb)<<"[DB] Add user failed:"<<query.lastError().text();
+        return false;
+    }
+    const bool inserted = query.numRowsAffected() > 0;
+    query.finish();
+    // 写用户表后失效该用户的缓存记录，下次登录从数据库重新读取
+    userCache_.invalidate(username);
+    if(!inserted)
+    {
+        qCDebug(lcDb)<<"[DB] Add user failed: Username already exists ~"<<username;
         return false;
     }
-    qInfo()<<"[DB] User added successfully:"<<username;
+    qCInfo(lcDb)<<"[DB] User added successfully:"<<username;
     return true;
 }
+
+int DatabaseManager::warmUpCache(int limit)
+{
+    QSqlDatabase db = connection();
+    if(limit <= 0 || !db.isOpen())
+    {
+        return 0;
+    }
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT username, id, user_type, password_hash FROM users ORDER BY id DESC LIMIT :limit");
+    query.bindValue(":limit", qMin(limit, userCache_.capacity()));
+    if(!query.exec())
+    {
+        qCWarning(lcDb)<<"[DB] Cache warm-up failed:"<<query.lastError().text();
+        return 0;
+    }
+    // 先载入的是最近注册的用户；倒序写入，使其在 LRU 中最新
+    QVector<QPair<QString, UserRecord>> rows;
+    while(query.next())
+    {
+        UserRecord user;
+        user.id = query.value(1).toInt();
+        user.userType = query.value(2).toInt();
+        user.passwordHash = query.value(3).toString();
+        rows.append(qMakePair(query.value(0).toString(), user));
+    }
+    for(int i = rows.size() - 1; i >= 0; --i)
+    {
+        userCache_.insert(rows.at(i).first, rows.at(i).second);
+    }
+    qCInfo(lcDb)<<"[DB] User cache warmed up:"<<rows.size()<<"users";
+    return rows.size();
+}
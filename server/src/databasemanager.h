@@ -9,6 +9,9 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QCryptographicHash>
+#include <QThread>
+#include <QThreadStorage>
+#include "usercache.h"
 
 class DatabaseManager:public QObject
 {
@@ -19,14 +22,40 @@ public:
     DatabaseManager(const DatabaseManager&)=delete;
     DatabaseManager& operator=(const DatabaseManager&)=delete;\
 
+    // 在 initialize() 之前调用可改用其他数据库文件（基准测试用临时文件）
+    void setDatabasePath(const QString &path);
+    // 打开数据库、设置 WAL/synchronous 并执行尚未执行的迁移
     bool initialize();
     bool addUser(const QString &username,const QString &password,const QString &email,const QString &phone,int userType);
     bool validateUser(const QString &username,const QString &password,int userType);
     bool userExists(const QString &username);
 
+    // 用户记录缓存（validateUser 先查缓存，addUser 写入后失效）
+    UserCache& userCache() { return userCache_; }
+    // 预热：按最近注册顺序载入最多 limit 个用户，返回载入数
+    int warmUpCache(int limit);
+
 private:
     explicit DatabaseManager(QObject *parent = nullptr);
     ~DatabaseManager();
+    // 数据库连接：只能在 DB 线程（DbWorker）中调用，其他线程调用会触发断言
+    QSqlDatabase connection();
+    bool configure(QSqlDatabase &db);
+    bool migrate();
+
+    // 每个连接缓存的预编译语句
+    struct Statements
+    {
+        explicit Statements(const QSqlDatabase &db) : lookup(db), exists(db), insert(db) {}
+        QSqlQuery lookup;
+        QSqlQuery exists;
+        QSqlQuery insert;
+    };
+    Statements* statements(const QSqlDatabase &db);
+    QThreadStorage<Statements*> statements_;
+    bool loadUser(const QSqlDatabase &db, const QString &username, UserRecord *out);
+    UserCache userCache_;
+
     QSqlDatabase db_;
     QString connectionName_;
 };
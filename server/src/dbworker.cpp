@@ -0,0 +1,96 @@
+#include "dbworker.h"
+#include "databasemanager.h"
+#include "logging.h"
+
+// 排队过深时告警（登录风暴），限频输出
+static const int kPendingWarn = 256;
+
+DbWorker& DbWorker::instance()
+{
+    static DbWorker worker;
+    return worker;
+}
+
+DbWorker::DbWorker()
+{
+    thread_.setObjectName("hub-db");
+    moveToThread(&thread_);
+}
+
+DbWorker::~DbWorker()
+{
+    stop();
+}
+
+bool DbWorker::start()
+{
+    if (started_) return initialized_;
+    started_ = true;
+    thread_.start();
+
+    bool ok = false;
+    const int capacity = cacheCapacity_;
+    QMetaObject::invokeMethod(this, [&ok, capacity]() {
+        DatabaseManager& db = DatabaseManager::instance();
+        db.userCache().setCapacity(capacity);
+        ok = db.initialize();
+    }, Qt::BlockingQueuedConnection);
+    initialized_ = ok;
+
+    if (ok && cacheWarmUp_ > 0 && cacheCapacity_ > 0) {
+        const int warmUp = cacheWarmUp_;
+        QMetaObject::invokeMethod(this, [warmUp]() {
+            DatabaseManager::instance().warmUpCache(warmUp);
+        }, Qt::QueuedConnection);
+    }
+    return ok;
+}
+
+QJsonObject DbWorker::cacheStats() const
+{
+    if (!initialized_) return QJsonObject();
+    return DatabaseManager::instance().userCache().stats();
+}
+
+void DbWorker::stop()
+{
+    if (!thread_.isRunning()) return;
+    if (initialized_)
+        qCInfo(lcDb) << "[DB] User cache:" << QJsonDocument(cacheStats()).toJson(QJsonDocument::Compact);
+    thread_.quit();
+    thread_.wait();
+}
+
+void DbWorker::validateUser(const QString& username, const QString& password, int userType,
+                            QObject* context, std::function<void(bool)> done)
+{
+    post(context, [username, password, userType]() {
+        return DatabaseManager::instance().validateUser(username, password, userType);
+    }, std::move(done));
+}
+
+void DbWorker::addUser(const QString& username, const QString& password, const QString& email,
+                       const QString& phone, int userType,
+                       QObject* context, std::function<void(bool)> done)
+{
+    post(context, [username, password, email, phone, userType]() {
+        return DatabaseManager::instance().addUser(username, password, email, phone, userType);
+    }, std::move(done));
+}
+
+// job 在 DB 线程执行，结果经 context 的事件队列回到其线程
+void DbWorker::post(QObject* context, std::function<bool()> job, std::function<void(bool)> done)
+{
+    const int depth = pending_.fetchAndAddRelaxed(1) + 1;
+    if (depth >= kPendingWarn) {
+        static LogThrottle throttle(1000);
+        if (throttle.allow())
+            qCWarning(lcDb) << "[DB] 请求排队" << depth << "个";
+    }
+
+    QMetaObject::invokeMethod(this, [this, context, job, done]() {
+        const bool ok = job();
+        pending_.fetchAndAddRelaxed(-1);
+        QMetaObject::invokeMethod(context, [done, ok]() { done(ok); }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
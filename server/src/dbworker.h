@@ -0,0 +1,49 @@
+#pragma once
+// ===============================================
+// server/src/dbworker.h
+// 异步数据库服务：专用线程 + 该线程自己的 SQLite 连接
+// - 请求排队到 DB 线程依次执行（查询与 SHA-256 都在该线程），事件循环不再等待数据库
+// - 结果投递回调用方指定的 context 对象所在线程，在该线程调用完成回调
+// - DatabaseManager 首次在 DB 线程中构造，其默认连接归该线程所有
+// ===============================================
+#include <QtCore>
+#include <functional>
+
+class DbWorker : public QObject
+{
+    Q_OBJECT
+public:
+    static DbWorker& instance();
+
+    // 用户记录缓存：容量（0 关闭）与启动时预热的用户数；在 start() 之前调用
+    void setUserCache(int capacity, int warmUp) { cacheCapacity_ = capacity; cacheWarmUp_ = warmUp; }
+    // 启动 DB 线程并在其中初始化数据库（阻塞到初始化完成，预热在其后异步进行）；重复调用直接返回上次结果
+    bool start();
+    // 停止 DB 线程（已排队的请求执行完后退出，完成回调不再保证送达）
+    void stop();
+    // 用户记录缓存的命中统计，见 UserCache::stats()
+    QJsonObject cacheStats() const;
+
+    // 登录校验；done(ok) 在 context 所在线程调用（context 需存活到 stop()，通常是 RoomHub）
+    void validateUser(const QString& username, const QString& password, int userType,
+                      QObject* context, std::function<void(bool)> done);
+    // 注册；done(ok)：false 表示用户名已存在或写入失败
+    void addUser(const QString& username, const QString& password, const QString& email,
+                 const QString& phone, int userType,
+                 QObject* context, std::function<void(bool)> done);
+
+    // 已排队、尚未执行完的请求数
+    int pending() const { return pending_.load(); }
+
+private:
+    DbWorker();
+    ~DbWorker() override;
+    void post(QObject* context, std::function<bool()> job, std::function<void(bool)> done);
+
+    QThread thread_;
+    QAtomicInt pending_{0};
+    bool started_ = false;
+    bool initialized_ = false;
+    int cacheCapacity_ = 4096;
+    int cacheWarmUp_ = 0;
+};
@@ -0,0 +1,183 @@
+#include "egressqueue.h"
+#include "../../common/protocol.h"
+
+EgressQueue::Priority EgressQueue::priorityOf(quint16 type)
+{
+    switch (type) {
+    case MSG_SERVER_EVENT: return PrioServerEvent;
+    case MSG_CONTROL:      return PrioControl;
+    case MSG_DEVICE_DATA:  return PrioDevice;
+    case MSG_AUDIO_FRAME:  return PrioAudio;
+    case MSG_VIDEO_FRAME:  return PrioVideo;
+    default:               return PrioText; // 文本及其他不可丢弃的消息
+    }
+}
+
+bool EgressQueue::canWriteNow(Connection* sock) const
+{
+    return sock->bytesToWrite() < limits_.writeHighWater;
+}
+
+void EgressQueue::write(Connection* sock, const Item& item)
+{
+    sock->writeSegments(item.segs, item.count);
+}
+
+void EgressQueue::send(Connection* sock, quint16 type, const QByteArray* segs, int count,
+                       const QByteArray& keepAlive, quintptr source)
+{
+    Item item;
+    item.type = type;
+    item.source = source;
+    submit(sock, std::move(item), segs, count, keepAlive);
+}
+
+void EgressQueue::sendFragment(Connection* sock, quint16 type, const QByteArray* segs, int count,
+                               const QByteArray& keepAlive)
+{
+    Item item;
+    item.type = type;
+    item.pinned = true;
+    submit(sock, std::move(item), segs, count, keepAlive);
+}
+
+void EgressQueue::submit(Connection* sock, Item&& item, const QByteArray* segs, int count,
+                         const QByteArray& keepAlive)
+{
+    item.count = qMin(count, 3);
+    for (int i = 0; i < item.count; ++i) {
+        item.segs[i] = segs[i];
+        item.bytes += segs[i].size();
+    }
+
+    // 快速路径：没有积压且socket缓冲未超高水位，直接写
+    if (isEmpty() && canWriteNow(sock)) {
+        write(sock, item);
+        return;
+    }
+
+    item.keepAlive = keepAlive;
+    item.enqueuedMs = QDateTime::currentMSecsSinceEpoch();
+    enqueue(std::move(item));
+    flush(sock);
+}
+
+void EgressQueue::enqueue(Item&& item)
+{
+    const Priority prio = priorityOf(item.type);
+    QList<Item>& q = queues_[prio];
+
+    if (item.pinned) {
+        // 分片：保持流内顺序，不参与丢弃策略
+    } else if (prio == PrioVideo) {
+        // 同一发送方只保留最新一帧
+        for (int i = q.size() - 1; i >= 0; --i)
+            if (!q.at(i).pinned && q.at(i).source == item.source)
+                dropAt(prio, i);
+    } else if (prio == PrioAudio) {
+        int n = 0;
+        for (const Item& it : q)
+            if (!it.pinned && it.source == item.source) ++n;
+        for (int i = 0; n >= limits_.audioFrames && i < q.size(); ) {
+            if (!q.at(i).pinned && q.at(i).source == item.source) {
+                dropAt(prio, i);
+                --n;
+            } else {
+                ++i;
+            }
+        }
+    } else if (prio == PrioDevice) {
+        int n = 0;
+        for (const Item& it : q)
+            if (!it.pinned) ++n;
+        for (int i = firstDroppable(prio); n >= limits_.deviceItems && i >= 0; i = firstDroppable(prio)) {
+            dropAt(prio, i);
+            --n;
+        }
+    }
+
+    queuedBytes_ += item.bytes;
+    ++queuedCount_;
+    q.append(std::move(item));
+    enforceByteLimit();
+}
+
+void EgressQueue::dropAt(Priority prio, int index)
+{
+    QList<Item>& q = queues_[prio];
+    const Item& it = q.at(index);
+    queuedBytes_ -= it.bytes;
+    --queuedCount_;
+    ++dropped_[it.type];
+    q.removeAt(index);
+}
+
+int EgressQueue::firstDroppable(Priority prio) const
+{
+    const QList<Item>& q = queues_[prio];
+    for (int i = 0; i < q.size(); ++i)
+        if (!q.at(i).pinned) return i;
+    return -1;
+}
+
+void EgressQueue::dropExpired(qint64 nowMs)
+{
+    // 队列按入队时间有序：遇到第一个未过期的可丢弃项即停止
+    const struct { Priority prio; qint64 maxAgeMs; } rules[] = {
+        { PrioVideo, limits_.videoMaxAgeMs },
+        { PrioAudio, limits_.audioMaxAgeMs }
+    };
+    for (const auto& r : rules) {
+        for (int i = firstDroppable(r.prio);
+             i >= 0 && nowMs - queues_[r.prio].at(i).enqueuedMs > r.maxAgeMs;
+             i = firstDroppable(r.prio))
+            dropAt(r.prio, i);
+    }
+}
+
+void EgressQueue::enforceByteLimit()
+{
+    static const Priority kDropOrder[] = { PrioVideo, PrioAudio, PrioDevice };
+    for (Priority prio : kDropOrder) {
+        for (int i = firstDroppable(prio); queuedBytes_ > limits_.maxBytes && i >= 0; i = firstDroppable(prio))
+            dropAt(prio, i);
+        if (queuedBytes_ <= limits_.maxBytes) return;
+    }
+}
+
+// 每次写出一项都重新从最高优先级选，低优先级的大帧不会阻塞之后到达的控制指令
+void EgressQueue::flush(Connection* sock)
+{
+    if (isEmpty()) return;
+    dropExpired(QDateTime::currentMSecsSinceEpoch());
+    while (!isEmpty() && canWriteNow(sock)) {
+        for (int prio = 0; prio < PrioCount; ++prio) {
+            QList<Item>& q = queues_[prio];
+            if (q.isEmpty()) continue;
+            Item item = q.takeFirst();
+            queuedBytes_ -= item.bytes;
+            --queuedCount_;
+            write(sock, item);
+            break;
+        }
+    }
+}
+
+quint64 EgressQueue::totalDropped() const
+{
+    quint64 n = 0;
+    for (quint64 v : dropped_) n += v;
+    return n;
+}
+
+QString EgressQueue::dropSummary() const
+{
+    QStringList parts;
+    for (auto it = dropped_.constBegin(); it != dropped_.constEnd(); ++it) {
+        const char* name = it.key() == MSG_VIDEO_FRAME ? "video"
+                         : it.key() == MSG_AUDIO_FRAME ? "audio"
+                         : it.key() == MSG_DEVICE_DATA ? "device" : "other";
+        parts << QString("%1=%2").arg(name).arg(it.value());
+    }
+    return parts.join(' ');
+}
@@ -0,0 +1,92 @@
+#pragma once
+// ===============================================
+// server/src/egressqueue.h
+// 每个接收方一个有界、按优先级调度的发送队列
+// - 所有队列为空且连接的用户态发送缓冲（bytesToWrite）低于高水位时直接写出，不排队
+// - 否则按优先级类别分别排队，bytesWritten 时总是先写最高优先级的非空队列：
+//   服务器事件 > 控制 > 文本 > 设备数据 > 音频 > 视频
+//   这样控制指令不会排在几百KB视频帧之后
+// - 各类别的丢弃策略：
+//   视频：同一发送方只保留最新一帧（旧帧未发出即丢弃）
+//   音频：同一发送方最多 audioFrames 帧，且超过 audioMaxAgeMs 的丢弃
+//   设备数据：最多 deviceItems 条，超出丢最旧
+//   文本/控制/服务器事件：从不丢弃
+//   直通转发的分片（sendFragment）：从不丢弃，丢掉任何一片都会让接收方的整帧作废
+// - 队列总字节超过 maxBytes 时，按 视频 > 音频 > 设备数据 的顺序丢最旧的可丢弃项
+// 排队项持有接收块的引用（keepAlive），不复制帧数据
+// ===============================================
+#include <QtCore>
+#include "transport.h"
+
+class EgressQueue
+{
+public:
+    // 优先级类别（数值越小越优先）
+    enum Priority {
+        PrioServerEvent = 0,
+        PrioControl,
+        PrioText,
+        PrioDevice,
+        PrioAudio,
+        PrioVideo,
+        PrioCount
+    };
+    static Priority priorityOf(quint16 type);
+
+    struct Limits {
+        int writeHighWater = 16 * 1024;      // 连接的用户态发送缓冲超过此值时开始排队（越小，高优先级消息插队越及时）
+        int maxBytes = 4 * 1024 * 1024;      // 排队总字节上限（可丢弃项）
+        int audioFrames = 10;                // 每个发送方排队的音频帧上限（约200ms）
+        qint64 audioMaxAgeMs = 200;
+        qint64 videoMaxAgeMs = 1000;
+        int deviceItems = 256;
+    };
+
+    // 发送一条消息（segs 为帧的若干段，调用返回前可能只是视图；需要排队时由 keepAlive 保持数据有效）
+    // source 标识发送方（用于“每个发送方只保留最新视频帧”），服务器自身消息传 0
+    void send(Connection* sock, quint16 type, const QByteArray* segs, int count,
+              const QByteArray& keepAlive = QByteArray(), quintptr source = 0);
+    // 发送一个直通转发的分片帧：按 type 的优先级排队，但不参与丢弃策略
+    void sendFragment(Connection* sock, quint16 type, const QByteArray* segs, int count,
+                      const QByteArray& keepAlive);
+    // 该类型所在优先级是否有积压（积压时不再为新的分片流直通，改发重组后的完整帧）
+    bool hasBacklog(quint16 type) const { return !queues_[priorityOf(type)].isEmpty(); }
+    // socket可写（bytesWritten）时调用，继续写出排队项
+    void flush(Connection* sock);
+
+    void setLimits(const Limits& limits) { limits_ = limits; }
+    int queuedBytes() const { return queuedBytes_; }
+    int queuedItems() const { return queuedCount_; }
+    quint64 dropped(quint16 type) const { return dropped_.value(type); }
+    quint64 totalDropped() const;
+    QString dropSummary() const; // 例如 "video=12 audio=3"
+
+private:
+    struct Item {
+        quint16 type = 0;
+        quintptr source = 0;
+        QByteArray segs[3];
+        int count = 0;
+        int bytes = 0;
+        QByteArray keepAlive;
+        qint64 enqueuedMs = 0;
+        bool pinned = false; // 不可丢弃（分片）
+    };
+
+    bool isEmpty() const { return queuedCount_ == 0; }
+    bool canWriteNow(Connection* sock) const;
+    void submit(Connection* sock, Item&& item, const QByteArray* segs, int count,
+                const QByteArray& keepAlive);
+    void write(Connection* sock, const Item& item);
+    void enqueue(Item&& item);
+    void dropAt(Priority prio, int index);
+    int firstDroppable(Priority prio) const;
+    void dropExpired(qint64 nowMs);
+    void enforceByteLimit();
+
+    Limits limits_;
+    QList<Item> queues_[PrioCount];
+    int queuedCount_ = 0;
+    int queuedBytes_ = 0;
+    QHash<quint16, quint64> dropped_;
+};
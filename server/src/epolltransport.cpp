@@ -0,0 +1,381 @@
+#include "epolltransport.h"
+
+#ifdef Q_OS_LINUX
+
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+static bool wouldBlock(int err)
+{
+    return err == EAGAIN || err == EWOULDBLOCK;
+}
+
+// ---- EpollConnection ----
+
+EpollConnection::EpollConnection(int fd, QObject* parent) : Connection(parent), fd_(fd)
+{
+    sockaddr_storage ss;
+    socklen_t len = sizeof(ss);
+    if (::getpeername(fd_, reinterpret_cast<sockaddr*>(&ss), &len) == 0) {
+        peer_ = QHostAddress(reinterpret_cast<sockaddr*>(&ss));
+        peerPort_ = ss.ss_family == AF_INET6
+                  ? ntohs(reinterpret_cast<sockaddr_in6*>(&ss)->sin6_port)
+                  : ntohs(reinterpret_cast<sockaddr_in*>(&ss)->sin_port);
+    }
+}
+
+// 析构时才关闭描述符：对象存活期间 fd 号不会被新连接复用
+EpollConnection::~EpollConnection()
+{
+    if (transport_) transport_->remove(this);
+    ::close(fd_);
+}
+
+qint64 EpollConnection::bytesAvailable() const
+{
+    int n = 0;
+    if (!connected_ || ::ioctl(fd_, FIONREAD, &n) < 0) return 0;
+    return n;
+}
+
+// 每次只读一块：还有剩余时排队再发一次 readyRead，避免单个连接独占事件循环
+QByteArray EpollConnection::read()
+{
+    if (!connected_ || !readable_ || !transport_) return QByteArray();
+
+    QByteArray data;
+    const qint64 n = transport_->receive(fd_, data);
+    if (n > 0) {
+        if (bytesAvailable() > 0)
+            QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection);
+        else if (peerClosed_)
+            markClosed(); // 数据已读完且对端已关闭（边沿触发下不会再有事件）
+        else
+            readable_ = false;
+        return data;
+    }
+    if (n < 0 && wouldBlock(errno)) {
+        readable_ = false;
+        return QByteArray();
+    }
+    markClosed(); // n == 0：对端关闭；其余为连接错误
+    return QByteArray();
+}
+
+qint64 EpollConnection::writeSegments(const QByteArray* segs, int count)
+{
+    if (!connected_) return -1;
+
+    qint64 total = 0;
+    for (int i = 0; i < count; ++i) total += segs[i].size();
+
+    int first = 0;   // 尚未完整写出的第一段
+    qint64 skip = 0; // 该段中已被内核接收的字节数
+    if (bytesToWrite() == 0) {
+        struct iovec iov[8];
+        int n = 0;
+        for (int i = 0; i < count && n < 8; ++i) {
+            if (segs[i].isEmpty()) continue;
+            iov[n].iov_base = const_cast<char*>(segs[i].constData());
+            iov[n].iov_len = size_t(segs[i].size());
+            ++n;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        ssize_t sent = 0;
+        if (n > 0) {
+            do { sent = ::sendmsg(fd_, &msg, MSG_NOSIGNAL | MSG_DONTWAIT); } while (sent < 0 && errno == EINTR);
+        }
+        if (sent < 0) {
+            if (!wouldBlock(errno)) {
+                markClosed();
+                return -1;
+            }
+            sent = 0;
+        }
+        qint64 left = sent;
+        while (first < count && left >= segs[first].size()) {
+            left -= segs[first].size();
+            ++first;
+        }
+        skip = left;
+    }
+
+    // 内核放不下的部分进入用户态缓冲，EPOLLOUT 时续写
+    for (int i = first; i < count; ++i) {
+        const qint64 off = (i == first) ? skip : 0;
+        if (segs[i].size() - off > 0)
+            out_.append(segs[i].constData() + off, int(segs[i].size() - off));
+    }
+    return total;
+}
+
+void EpollConnection::flushPending()
+{
+    qint64 written = 0;
+    while (connected_ && outPos_ < out_.size()) {
+        const ssize_t n = ::send(fd_, out_.constData() + outPos_, size_t(out_.size() - outPos_),
+                                 MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (!wouldBlock(errno)) markClosed();
+            break;
+        }
+        outPos_ += int(n);
+        written += n;
+    }
+    if (outPos_ >= out_.size()) {
+        out_.clear();
+        outPos_ = 0;
+    } else if (outPos_ >= 64 * 1024 && outPos_ * 2 >= out_.size()) {
+        out_.remove(0, outPos_);
+        outPos_ = 0;
+    }
+    if (written > 0)
+        emit bytesWritten(written);
+}
+
+void EpollConnection::setSendBufferSize(int bytes)
+{
+    ::setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+}
+
+// 先续写，再通知可读；readyRead 放在最后（处理过程中连接可能被迁移到其他线程，之后不再访问成员）
+void EpollConnection::handleEvents(quint32 events)
+{
+    if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        peerClosed_ = true;
+    if (events & EPOLLOUT)
+        flushPending();
+    // 对端已关闭且没有待读数据：直接断开，不依赖上层再调用 read()（例如等待数据库结果期间暂停读取）
+    if (connected_ && peerClosed_ && bytesAvailable() == 0) {
+        markClosed();
+        return;
+    }
+    if (connected_ && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        readable_ = true;
+        emit readyRead();
+    }
+}
+
+// 停止收发并从 epoll 注销；disconnected 排队发出，不在 read()/write 的调用栈里重入 RoomHub
+void EpollConnection::markClosed()
+{
+    if (!connected_) return;
+    connected_ = false;
+    readable_ = false;
+    if (transport_) transport_->remove(this);
+    QMetaObject::invokeMethod(this, "disconnected", Qt::QueuedConnection);
+}
+
+// ---- EpollTransport ----
+
+EpollTransport::EpollTransport(QObject* parent) : Transport(parent)
+{
+}
+
+EpollTransport::~EpollTransport()
+{
+    if (listenFd_ >= 0) ::close(listenFd_);
+    if (epfd_ >= 0) ::close(epfd_);
+}
+
+bool EpollTransport::fail(const char* what)
+{
+    error_ = QString("%1: %2").arg(what).arg(QString::fromLocal8Bit(strerror(errno)));
+    return false;
+}
+
+// 在所属线程首次使用时创建（RoomHub 构造后才被移到worker线程）
+bool EpollTransport::ensureEpoll()
+{
+    if (epfd_ >= 0) return true;
+    epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0) return fail("epoll_create1");
+    notifier_ = new QSocketNotifier(epfd_, QSocketNotifier::Read, this);
+    // activated 在 Qt 5.15 有重载，这里用字符串形式连接
+    connect(notifier_, SIGNAL(activated(int)), this, SLOT(onEvents()));
+    return true;
+}
+
+bool EpollTransport::listen(const QHostAddress& address, quint16 port)
+{
+    if (!ensureEpoll()) return false;
+
+    const bool v6 = address == QHostAddress::Any || address.protocol() == QAbstractSocket::IPv6Protocol;
+    const int fd = ::socket(v6 ? AF_INET6 : AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return fail("socket");
+    const int one = 1, zero = 0;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_storage ss;
+    memset(&ss, 0, sizeof(ss));
+    socklen_t len = 0;
+    if (v6) {
+        ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero)); // 双栈
+        auto* a = reinterpret_cast<sockaddr_in6*>(&ss);
+        a->sin6_family = AF_INET6;
+        a->sin6_port = htons(port);
+        if (address == QHostAddress::Any) {
+            a->sin6_addr = in6addr_any;
+        } else {
+            const Q_IPV6ADDR ip = address.toIPv6Address();
+            memcpy(&a->sin6_addr, &ip, sizeof(ip));
+        }
+        len = sizeof(sockaddr_in6);
+    } else {
+        auto* a = reinterpret_cast<sockaddr_in*>(&ss);
+        a->sin_family = AF_INET;
+        a->sin_port = htons(port);
+        a->sin_addr.s_addr = htonl(address.toIPv4Address());
+        len = sizeof(sockaddr_in);
+    }
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&ss), len) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+        fail("bind/listen");
+        ::close(fd);
+        return false;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = nullptr; // 监听socket
+    if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        fail("epoll_ctl");
+        ::close(fd);
+        return false;
+    }
+    listenFd_ = fd;
+    len = sizeof(ss);
+    if (::getsockname(fd, reinterpret_cast<sockaddr*>(&ss), &len) == 0)
+        serverAddress_ = QHostAddress(reinterpret_cast<sockaddr*>(&ss));
+    return true;
+}
+
+bool EpollTransport::add(EpollConnection* conn)
+{
+    if (!ensureEpoll()) return false;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    // 读写一起以边沿触发登记：EPOLLOUT 只在发送缓冲由满变为可写时通知一次，无需反复修改兴趣集
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = conn;
+    if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, conn->fd_, &ev) < 0) return fail("epoll_ctl");
+    conn->transport_ = this;
+    return true;
+}
+
+void EpollTransport::remove(EpollConnection* conn)
+{
+    if (epfd_ >= 0) ::epoll_ctl(epfd_, EPOLL_CTL_DEL, conn->fd_, nullptr);
+    conn->transport_ = nullptr;
+}
+
+void EpollTransport::acceptAll()
+{
+    for (;;) {
+        const int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (!wouldBlock(errno)) fail("accept4"); // 例如 EMFILE：等下一次边沿
+            return;
+        }
+        auto* conn = new EpollConnection(fd);
+        if (!add(conn)) {
+            delete conn;
+            continue;
+        }
+        emit newConnection(conn);
+    }
+}
+
+Connection* EpollTransport::adoptDescriptor(qintptr socketDescriptor)
+{
+    const int fd = int(socketDescriptor);
+    const int flags = ::fcntl(fd, F_GETFL);
+    if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        fail("fcntl");
+        ::close(fd);
+        return nullptr;
+    }
+    auto* conn = new EpollConnection(fd);
+    if (!add(conn)) {
+        delete conn;
+        return nullptr;
+    }
+    return conn;
+}
+
+void EpollTransport::release(Connection* conn, QThread* target)
+{
+    auto* c = static_cast<EpollConnection*>(conn);
+    if (c->transport_) remove(c);
+    conn->setParent(nullptr);
+    conn->moveToThread(target);
+}
+
+// 重新登记时内核会按当前状态补发一次边沿（迁移途中到达的数据、发送缓冲可写）
+void EpollTransport::adopt(Connection* conn)
+{
+    auto* c = static_cast<EpollConnection*>(conn);
+    if (!c->isConnected()) return;
+    if (!add(c)) {
+        c->markClosed();
+        return;
+    }
+    c->readable_ = true; // 允许调用方立即读取迁移途中到达的数据
+}
+
+void EpollTransport::onEvents()
+{
+    struct epoll_event events[128];
+    int n;
+    do { n = ::epoll_wait(epfd_, events, 128, 0); } while (n < 0 && errno == EINTR);
+    for (int i = 0; i < n; ++i) {
+        if (!events[i].data.ptr)
+            acceptAll();
+        else
+            static_cast<EpollConnection*>(events[i].data.ptr)->handleEvents(events[i].events);
+    }
+}
+
+// 优先复用已无人引用的块：接收块与 Packet 视图隐式共享，最后一个引用释放后即可重用
+qint64 EpollTransport::receive(int fd, QByteArray& out)
+{
+    QByteArray scratch;
+    QByteArray* block = nullptr;
+    for (QByteArray& b : pool_) {
+        if (b.isDetached()) {
+            block = &b;
+            break;
+        }
+    }
+    if (!block) {
+        if (pool_.size() < kMaxPooledBlocks) {
+            pool_.append(QByteArray());
+            block = &pool_.last();
+        } else {
+            block = &scratch;
+        }
+    }
+    block->resize(kBlockSize); // 容量足够时只改长度，不重新分配
+
+    ssize_t n;
+    do { n = ::recv(fd, block->data(), size_t(kBlockSize), 0); } while (n < 0 && errno == EINTR);
+    if (n > 0) {
+        block->resize(int(n));
+        out = *block;
+    }
+    return n;
+}
+
+#endif // Q_OS_LINUX
@@ -0,0 +1,90 @@
+#pragma once
+// ===============================================
+// server/src/epolltransport.h
+// Linux 原生传输（--transport epoll）
+// - 每个 Transport 一个边沿触发的 epoll 实例，epoll fd 本身挂在 Qt 事件循环上（QSocketNotifier），
+//   worker 线程仍可使用定时器与跨线程调用
+// - 接收：recv 直接写入池化的 64KB 块，块以隐式共享交给 PacketBuffer/Packet；
+//   全部引用释放后块回到池中复用，稳态下不再为每次读取分配内存
+// - 发送：用户态缓冲为空时 sendmsg（iovec）直接写内核，剩余部分才复制进用户态缓冲，EPOLLOUT 时续写
+// ===============================================
+#include "transport.h"
+
+#ifdef Q_OS_LINUX
+
+class EpollTransport;
+
+class EpollConnection : public Connection
+{
+    Q_OBJECT
+public:
+    explicit EpollConnection(int fd, QObject* parent = nullptr);
+    ~EpollConnection() override;
+
+    QByteArray read() override;
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override { return out_.size() - outPos_; }
+    qint64 writeSegments(const QByteArray* segs, int count) override;
+    bool isConnected() const override { return connected_; }
+    QHostAddress peerAddress() const override { return peer_; }
+    quint16 peerPort() const override { return peerPort_; }
+    void setSendBufferSize(int bytes) override;
+
+private:
+    friend class EpollTransport;
+    void handleEvents(quint32 events);
+    void flushPending();
+    void markClosed();
+
+    int fd_;
+    EpollTransport* transport_ = nullptr; // 当前登记的 epoll 实例（迁移途中为空）
+    bool connected_ = true;
+    bool readable_ = false;
+    bool peerClosed_ = false; // 已收到 RDHUP/HUP/ERR，读完剩余数据后断开
+    QByteArray out_;   // 用户态发送缓冲，[outPos_, size) 未写出
+    int outPos_ = 0;
+    QHostAddress peer_;
+    quint16 peerPort_ = 0;
+};
+
+class EpollTransport : public Transport
+{
+    Q_OBJECT
+public:
+    explicit EpollTransport(QObject* parent = nullptr);
+    ~EpollTransport() override;
+
+    QString name() const override { return QStringLiteral("epoll"); }
+    bool listen(const QHostAddress& address, quint16 port) override;
+    QHostAddress serverAddress() const override { return serverAddress_; }
+    QString errorString() const override { return error_; }
+    Connection* adoptDescriptor(qintptr socketDescriptor) override;
+    void release(Connection* conn, QThread* target) override;
+    void adopt(Connection* conn) override;
+
+    // 从 fd 读一次到池化块；返回 recv 的结果，>0 时 out 与该块共享
+    qint64 receive(int fd, QByteArray& out);
+
+private slots:
+    void onEvents();
+
+private:
+    friend class EpollConnection;
+    bool ensureEpoll();
+    bool add(EpollConnection* conn);
+    void remove(EpollConnection* conn);
+    void acceptAll();
+    bool fail(const char* what);
+
+    static const int kBlockSize = 64 * 1024;
+    static const int kMaxPooledBlocks = 128; // 每线程最多 8MB
+
+    int epfd_ = -1;
+    int listenFd_ = -1;
+    QSocketNotifier* notifier_ = nullptr;
+    QHostAddress serverAddress_;
+    QString error_;
+    QVector<QByteArray> pool_;
+};
+
+#endif // Q_OS_LINUX
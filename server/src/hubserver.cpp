@@ -0,0 +1,62 @@
+#include "hubserver.h"
+#include "roomhub.h"
+#include "logging.h"
+#include "dbworker.h"
+
+HubServer::HubServer(int workers, const QString& transport, QObject* parent) : QTcpServer(parent)
+{
+    for (int i = 0; i < workers; ++i) {
+        auto* thread = new QThread(this);
+        thread->setObjectName(QString("hub-worker-%1").arg(i));
+        auto* hub = new RoomHub(transport);
+        hub->setDirectory(&directory_);
+        hub->moveToThread(thread);
+        connect(thread, &QThread::finished, hub, &QObject::deleteLater);
+        threads_.append(thread);
+        hubs_.append(hub);
+        thread->start();
+    }
+}
+
+void HubServer::setRecorder(Recorder* recorder)
+{
+    // 队列在worker线程开始转发之前创建，之后只由该worker写入
+    for (RoomHub* hub : hubs_)
+        hub->setRecorder(recorder);
+}
+
+HubServer::~HubServer()
+{
+    close();
+    for (QThread* t : threads_) {
+        t->quit();
+        t->wait();
+    }
+}
+
+bool HubServer::start(quint16 port)
+{
+    if (!DbWorker::instance().start())
+    {
+        qCCritical(lcServer) << "Failed to initialize database!";
+        return false;
+    }
+    if (!listen(QHostAddress::Any, port))
+    {
+        qCWarning(lcServer) << "端口" << port << "监听失败:" << errorString();
+        return false;
+    }
+    qCInfo(lcServer) << "服务器正在监听" << serverAddress().toString() << ":" << port
+            << "，worker线程数：" << hubs_.size();
+    return true;
+}
+
+// 不在accept线程创建QTcpSocket：直接把描述符交给worker，由其在自己的线程里创建socket
+void HubServer::incomingConnection(qintptr socketDescriptor)
+{
+    RoomHub* hub = hubs_.at(next_);
+    next_ = (next_ + 1) % hubs_.size();
+    QMetaObject::invokeMethod(hub, [hub, socketDescriptor]() {
+        hub->adoptDescriptor(socketDescriptor);
+    }, Qt::QueuedConnection);
+}
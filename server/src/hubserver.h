@@ -0,0 +1,35 @@
+#pragma once
+// ===============================================
+// server/src/hubserver.h
+// 多线程服务器（--workers N）：主线程只负责accept，
+// 新连接的描述符轮询分配给 N 个worker线程，每个worker运行一个 RoomHub 和自己的事件循环。
+// 客户端加入的房间属于其他worker时，连接迁移到该worker（见 RoomHub::migrateClient）。
+// ===============================================
+#include <QtCore>
+#include <QtNetwork>
+#include "roomdirectory.h"
+
+class RoomHub;
+class Recorder;
+
+class HubServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    // transport: 各worker使用的传输层（"qt"/"epoll"），accept 仍由本对象完成
+    explicit HubServer(int workers, const QString& transport = QStringLiteral("qt"), QObject* parent = nullptr);
+    ~HubServer() override;
+
+    bool start(quint16 port);
+    // 各worker各自一个录制队列（见 RoomHub::setRecorder）；在 start 之前调用
+    void setRecorder(Recorder* recorder);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    RoomDirectory directory_;
+    QVector<QThread*> threads_;
+    QVector<RoomHub*> hubs_;
+    int next_ = 0;
+};
@@ -0,0 +1,139 @@
+#include "logging.h"
+#include <cstdio>
+
+Q_LOGGING_CATEGORY(lcServer, "hub.server")
+Q_LOGGING_CATEGORY(lcNet, "hub.net")
+Q_LOGGING_CATEGORY(lcRoom, "hub.room")
+Q_LOGGING_CATEGORY(lcAuth, "hub.auth")
+Q_LOGGING_CATEGORY(lcDb, "hub.db")
+Q_LOGGING_CATEGORY(lcRec, "hub.rec")
+
+bool LogThrottle::allow(int* suppressed)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 next = nextMs_.loadAcquire();
+    if (now < next || !nextMs_.testAndSetOrdered(next, now + intervalMs_)) {
+        suppressed_.fetchAndAddRelaxed(1);
+        return false;
+    }
+    const int n = suppressed_.fetchAndStoreRelaxed(0);
+    if (suppressed) *suppressed = n;
+    return true;
+}
+
+AsyncLogger& AsyncLogger::instance()
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    shutdown();
+}
+
+bool AsyncLogger::open(const QString& path)
+{
+    if (path.isEmpty()) return true;
+    file_.setFileName(path);
+    return file_.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+}
+
+void AsyncLogger::install()
+{
+    if (isRunning()) return;
+    setObjectName("hub-log");
+    start(QThread::LowPriority);
+    previous_ = qInstallMessageHandler(&AsyncLogger::messageHandler);
+}
+
+void AsyncLogger::shutdown()
+{
+    if (!isRunning()) return;
+    qInstallMessageHandler(previous_);
+    {
+        QMutexLocker lock(&mutex_);
+        stopping_ = true;
+        wake_.wakeOne();
+    }
+    wait();
+}
+
+void AsyncLogger::enqueue(const QByteArray& line)
+{
+    QMutexLocker lock(&mutex_);
+    if (pending_.size() >= kMaxPendingLines) {
+        ++dropped_;
+        return;
+    }
+    pending_.append(line);
+}
+
+// 在调用线程完成格式化，只持锁入队；致命错误同步写出后终止
+void AsyncLogger::messageHandler(QtMsgType type, const QMessageLogContext& ctx, const QString& msg)
+{
+    static const char* const kLevel[] = { "D", "W", "C", "F", "I" };
+    const char* level = kLevel[qBound(0, int(type), 4)];
+    const QString thread = QThread::currentThread()->objectName();
+    QByteArray line = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz").toUtf8();
+    line += ' ';
+    line += level;
+    line += " [";
+    line += ctx.category ? ctx.category : "default";
+    if (!thread.isEmpty()) {
+        line += '|';
+        line += thread.toUtf8();
+    }
+    line += "] ";
+    line += msg.toUtf8();
+    line += '\n';
+
+    AsyncLogger& self = instance();
+    if (type == QtFatalMsg) {
+        self.shutdown();
+        fputs(line.constData(), stderr);
+        abort();
+    }
+    self.enqueue(line);
+}
+
+void AsyncLogger::run()
+{
+    QVector<QByteArray> batch;
+    for (;;) {
+        quint64 dropped = 0;
+        bool stopping = false;
+        {
+            QMutexLocker lock(&mutex_);
+            if (pending_.isEmpty() && !stopping_)
+                wake_.wait(&mutex_, kFlushIntervalMs);
+            batch.swap(pending_);
+            dropped = dropped_;
+            dropped_ = 0;
+            stopping = stopping_;
+        }
+        if (!batch.isEmpty() || dropped > 0)
+            writeBatch(batch, dropped);
+        batch.clear();
+        if (stopping) break;
+    }
+}
+
+void AsyncLogger::writeBatch(const QVector<QByteArray>& batch, quint64 dropped)
+{
+    QByteArray out;
+    int size = 0;
+    for (const QByteArray& line : batch) size += line.size();
+    out.reserve(size + 64);
+    for (const QByteArray& line : batch) out += line;
+    if (dropped > 0)
+        out += QByteArray("[hub.log] dropped ") + QByteArray::number(dropped) + " lines (queue full)\n";
+
+    if (file_.isOpen()) {
+        file_.write(out);
+        file_.flush();
+    } else {
+        fwrite(out.constData(), 1, size_t(out.size()), stderr);
+        fflush(stderr);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+// ===============================================
+// server/src/logging.h
+// 服务器日志：按子系统分类（QLoggingCategory），异步批量写出
+// - 编译期：release 构建定义 QT_NO_DEBUG_OUTPUT，qCDebug 整条语句（含参数格式化）被编译掉
+// - 运行期：--log-rules 或 QT_LOGGING_RULES 按分类开关，例如 "hub.net.debug=true"
+// - 热路径日志用 LogThrottle 限频，被抑制的条数随下一条输出
+// - AsyncLogger 接管 Qt 消息处理：调用线程只格式化并入队，后台线程批量写文件/stderr，
+//   事件循环从不等待日志I/O；队列满时丢弃并计数
+// ===============================================
+#include <QtCore>
+
+Q_DECLARE_LOGGING_CATEGORY(lcServer) // hub.server：启动、监听、worker
+Q_DECLARE_LOGGING_CATEGORY(lcNet)    // hub.net：连接、收发、发送队列
+Q_DECLARE_LOGGING_CATEGORY(lcRoom)   // hub.room：加入/离开房间、迁移
+Q_DECLARE_LOGGING_CATEGORY(lcAuth)   // hub.auth：注册、登录
+Q_DECLARE_LOGGING_CATEGORY(lcDb)     // hub.db：数据库
+Q_DECLARE_LOGGING_CATEGORY(lcRec)    // hub.rec：会话录制
+
+// 限频：每 intervalMs 最多放行一次（线程安全，通常作为调用点的 static 对象）
+class LogThrottle
+{
+public:
+    explicit LogThrottle(qint64 intervalMs) : intervalMs_(intervalMs) {}
+    // 放行时返回 true，并通过 suppressed 返回上次放行以来被抑制的次数
+    bool allow(int* suppressed = nullptr);
+
+private:
+    const qint64 intervalMs_;
+    QAtomicInteger<qint64> nextMs_{0};
+    QAtomicInt suppressed_{0};
+};
+
+class AsyncLogger : public QThread
+{
+public:
+    static AsyncLogger& instance();
+
+    // path 为空时写 stderr；在 install() 之前调用
+    bool open(const QString& path);
+    // 安装 Qt 消息处理函数并启动写线程
+    void install();
+    // 写出剩余日志并停止写线程（程序退出前调用）
+    void shutdown();
+
+    void enqueue(const QByteArray& line);
+
+protected:
+    void run() override;
+
+private:
+    AsyncLogger() = default;
+    ~AsyncLogger() override;
+    static void messageHandler(QtMsgType type, const QMessageLogContext& ctx, const QString& msg);
+    void writeBatch(const QVector<QByteArray>& batch, quint64 dropped);
+
+    static const int kMaxPendingLines = 100000; // 写线程跟不上时的排队上限
+    static const int kFlushIntervalMs = 200;
+
+    QMutex mutex_;
+    QWaitCondition wake_;
+    QVector<QByteArray> pending_;
+    quint64 dropped_ = 0;
+    bool stopping_ = false;
+    QFile file_;
+    QtMessageHandler previous_ = nullptr;
+};
@@ -1,6 +1,12 @@
 ﻿#include <QtCore>    //Qt基本功能支持
 #include <QtNetwork> //网络相关功能支持
 #include "roomhub.h" //该类实现服务器核心功能
+#include "hubserver.h" //多worker线程模式
+#include "logging.h"   //日志分类与异步写出
+#include "dbworker.h"  //数据库线程
+#include "sessionstore.h" //可恢复会话
+#include "recorder.h"     //会话录制
+#include "timeseries.h"   //设备数据时序库
 #include <QSqlDatabase>
 #include <QDebug>
 
@@ -21,23 +27,134 @@ int main(int argc, char** argv)
     );
     // 将端口选项添加到解析器中
     parser.addOption(portOpt);
+    // worker线程数：0（默认）为单线程；N>0 时连接分配到N个worker事件循环，同一房间的成员在同一worker
+    QCommandLineOption workersOpt(
+        QStringList() << "w" << "workers",
+        "Worker threads (0 = single event loop)",
+        "n",
+        "0"
+    );
+    parser.addOption(workersOpt);
+    // 传输层：qt（默认，QTcpSocket）或 epoll（仅Linux，边沿触发epoll + 池化缓冲 + writev）
+    QCommandLineOption transportOpt(
+        QStringList() << "t" << "transport",
+        "Network transport: qt (default) or epoll (Linux only)",
+        "name",
+        "qt"
+    );
+    parser.addOption(transportOpt);
+    // 日志：写到文件（默认stderr），后台线程批量写出
+    QCommandLineOption logFileOpt(
+        QStringList() << "log-file",
+        "Write log to file (default: stderr)",
+        "path"
+    );
+    parser.addOption(logFileOpt);
+    // 日志分类开关，语法同 QT_LOGGING_RULES，多条用 ; 分隔，例如 "hub.net.debug=true;hub.db.info=false"
+    QCommandLineOption logRulesOpt(
+        QStringList() << "log-rules",
+        "Logging category rules, e.g. hub.net.debug=true",
+        "rules"
+    );
+    parser.addOption(logRulesOpt);
+    // 登录用的用户记录缓存：容量（0 关闭）与启动时预热的用户数（按最近注册）
+    QCommandLineOption userCacheOpt(
+        QStringList() << "user-cache",
+        "User record cache capacity (0 = disabled)",
+        "n",
+        "4096"
+    );
+    parser.addOption(userCacheOpt);
+    QCommandLineOption warmCacheOpt(
+        QStringList() << "warm-cache",
+        "Preload the n most recently registered users into the cache at startup",
+        "n",
+        "0"
+    );
+    parser.addOption(warmCacheOpt);
+    // 断线后会话保留时长：期间客户端凭 token 重连即可恢复身份与房间，并补发错过的聊天
+    QCommandLineOption sessionGraceOpt(
+        QStringList() << "session-grace",
+        "Seconds a disconnected session can be resumed",
+        "sec",
+        "30"
+    );
+    parser.addOption(sessionGraceOpt);
+    // 会话录制：转发的消息按工单写入该目录（<dir>/<百分号编码的ticket>/<baseMs>.seg|.idx，见 recording.h），不设置则不录制
+    QCommandLineOption recordDirOpt(
+        QStringList() << "record-dir",
+        "Record relayed packets per work order into <dir>/<percent-encoded ticket>/ as .seg/.idx segments",
+        "dir"
+    );
+    parser.addOption(recordDirOpt);
+    // 设备数据时序库：原始数据的保留时长（1秒/1分钟/1小时汇总分别保留15分钟/7天/400天）
+    QCommandLineOption deviceHistoryOpt(
+        QStringList() << "device-history",
+        "Hours of raw device samples kept in memory",
+        "hours",
+        "6"
+    );
+    parser.addOption(deviceHistoryOpt);
     // 处理命令行参// 静态哈希表：数，应用到应用程序中
     parser.process(app);
 
     // 从命令行解析器中获取端口值
     quint16 port = parser.value(portOpt).toUShort();
+    const int workers = parser.value(workersOpt).toInt();
+    const QString transport = parser.value(transportOpt);
+
+    // 默认关闭各分类的debug级别（热路径日志），需要时用 --log-rules 打开
+    QString logRules = QStringLiteral("hub.*.debug=false");
+    if (parser.isSet(logRulesOpt))
+        logRules += '\n' + parser.value(logRulesOpt).replace(';', '\n'); // 后出现的规则优先
+    QLoggingCategory::setFilterRules(logRules);
+    AsyncLogger& logger = AsyncLogger::instance();
+    if (!logger.open(parser.value(logFileOpt)))
+        qCWarning(lcServer) << "Cannot open log file" << parser.value(logFileOpt) << ", logging to stderr";
+    logger.install();
+    SessionStore::instance().setGracePeriod(parser.value(sessionGraceOpt).toInt() * 1000);
+    TimeSeriesStore::instance().setRawRetention(parser.value(deviceHistoryOpt).toLongLong() * 3600 * 1000);
+    DbWorker::instance().setUserCache(parser.value(userCacheOpt).toInt(),
+                                      parser.value(warmCacheOpt).toInt());
+    QScopedPointer<Recorder> recorder;
+    if (parser.isSet(recordDirOpt)) {
+        recorder.reset(new Recorder(parser.value(recordDirOpt)));
+        if (!recorder->open())
+            recorder.reset();
+    }
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, [&logger, &recorder]() {
+        DbWorker::instance().stop();
+        if (recorder) recorder->shutdown();
+        logger.shutdown();
+    });
+
+    if (workers > 0)
+    {
+        HubServer server(workers, transport);
+        server.setRecorder(recorder.data());
+        if (!server.start(port))
+        {
+            qCWarning(lcServer)<<"Listen failed on port"<<port<<":"<<server.errorString();
+            logger.shutdown();
+            return 1;
+        }
+        qCInfo(lcServer) << "Usage: clients connect to server_ip:" << port;
+        return app.exec();
+    }
 
-    RoomHub hub;
+    RoomHub hub(transport);
+    hub.setRecorder(recorder.data());
 
     // 启动服务器，尝试在指定端口上监听连接
     if (!hub.start(port))
     {
-        qWarning()<<"Listen failed on port"<<port<<":"<<hub.lastError();
+        qCWarning(lcServer)<<"Listen failed on port"<<port<<":"<<hub.lastError();
+        logger.shutdown();
         return 1;
     }
 
     // 告知用户客户端应连接的服务器端口
-    qInfo() << "Usage: clients connect to server_ip:" << port;
+    qCInfo(lcServer) << "Usage: clients connect to server_ip:" << port;
 
     // 进入Qt应用程序的事件循环，等待并处理各种事件（如网络连接、数据传输等）
     // 程序将一直运行直到调用quit()或exit()
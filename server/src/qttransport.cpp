@@ -0,0 +1,56 @@
+#include "qttransport.h"
+#include "../../common/protocol.h"
+
+QtConnection::QtConnection(QTcpSocket* sock, QObject* parent) : Connection(parent), sock_(sock)
+{
+    sock_->setParent(this);
+    connect(sock_, &QTcpSocket::readyRead, this, &Connection::readyRead);
+    connect(sock_, &QTcpSocket::bytesWritten, this, &Connection::bytesWritten);
+    connect(sock_, &QTcpSocket::disconnected, this, &Connection::disconnected);
+}
+
+qint64 QtConnection::writeSegments(const QByteArray* segs, int count)
+{
+    return ::writeSegments(sock_, segs, count);
+}
+
+void QtConnection::setSendBufferSize(int bytes)
+{
+    sock_->setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, bytes);
+}
+
+QtTransport::QtTransport(QObject* parent) : Transport(parent), server_(this)
+{
+    connect(&server_, &QTcpServer::newConnection, this, &QtTransport::onNewConnection);
+}
+
+bool QtTransport::listen(const QHostAddress& address, quint16 port)
+{
+    error_.clear();
+    return server_.listen(address, port);
+}
+
+void QtTransport::onNewConnection()
+{
+    while (server_.hasPendingConnections())
+        emit newConnection(new QtConnection(server_.nextPendingConnection()));
+}
+
+// socket在调用线程创建（无父对象，便于迁移）
+Connection* QtTransport::adoptDescriptor(qintptr socketDescriptor)
+{
+    auto* sock = new QTcpSocket;
+    if (!sock->setSocketDescriptor(socketDescriptor))
+    {
+        error_ = sock->errorString();
+        delete sock;
+        return nullptr;
+    }
+    return new QtConnection(sock);
+}
+
+void QtTransport::release(Connection* conn, QThread* target)
+{
+    conn->setParent(nullptr);
+    conn->moveToThread(target);
+}
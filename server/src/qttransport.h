@@ -0,0 +1,48 @@
+#pragma once
+// ===============================================
+// server/src/qttransport.h
+// 默认传输：QTcpServer/QTcpSocket 的薄封装，行为与引入传输层之前一致
+// ===============================================
+#include "transport.h"
+
+class QtConnection : public Connection
+{
+    Q_OBJECT
+public:
+    // 接管 sock（成为其父对象，随连接一起迁移线程/析构）
+    explicit QtConnection(QTcpSocket* sock, QObject* parent = nullptr);
+
+    QByteArray read() override { return sock_->readAll(); }
+    qint64 bytesAvailable() const override { return sock_->bytesAvailable(); }
+    qint64 bytesToWrite() const override { return sock_->bytesToWrite(); }
+    qint64 writeSegments(const QByteArray* segs, int count) override;
+    bool isConnected() const override { return sock_->state() == QAbstractSocket::ConnectedState; }
+    QHostAddress peerAddress() const override { return sock_->peerAddress(); }
+    quint16 peerPort() const override { return sock_->peerPort(); }
+    void setSendBufferSize(int bytes) override;
+
+private:
+    QTcpSocket* sock_;
+};
+
+class QtTransport : public Transport
+{
+    Q_OBJECT
+public:
+    explicit QtTransport(QObject* parent = nullptr);
+
+    QString name() const override { return QStringLiteral("qt"); }
+    bool listen(const QHostAddress& address, quint16 port) override;
+    QHostAddress serverAddress() const override { return server_.serverAddress(); }
+    QString errorString() const override { return error_.isEmpty() ? server_.errorString() : error_; }
+    Connection* adoptDescriptor(qintptr socketDescriptor) override;
+    void release(Connection* conn, QThread* target) override;
+    void adopt(Connection*) override {}
+
+private slots:
+    void onNewConnection();
+
+private:
+    QTcpServer server_;
+    QString error_;
+};
@@ -0,0 +1,218 @@
+#include "recorder.h"
+#include "logging.h"
+#include "../../common/protocol.h"
+
+// 每轮从一个队列最多取的条数：多个 worker 之间轮流，避免一个繁忙房间饿死其他队列
+static const int kDrainPerQueue = 1024;
+
+bool RecordQueue::push(const QString& ticket, const Packet& p)
+{
+    static LogThrottle dropLog(5000);
+    const QByteArray raw = p.frame();
+    const bool overBudget = bytes_.loadAcquire() + raw.size() > byteBudget_;
+    Item item;
+    if (!overBudget) {
+        item.ticket = ticket;
+        item.ms = QDateTime::currentMSecsSinceEpoch();
+        item.frame = raw;
+        item.keepAlive = p.block;
+    }
+    if (overBudget || !ring_.push(std::move(item))) {
+        dropped_.fetchAndAddRelaxed(1);
+        if (degraded_.testAndSetOrdered(0, 1))
+            qCWarning(lcRec) << "[REC] Recording degraded: writer is behind, dropping packets";
+        int suppressed = 0;
+        if (dropLog.allow(&suppressed))
+            qCWarning(lcRec) << "[REC] Dropped packet for" << ticket << "total" << dropped()
+                             << "suppressed" << suppressed;
+        return false;
+    }
+    bytes_.fetchAndAddRelaxed(raw.size());
+
+    // 积压降到一半以下才恢复，避免在阈值附近反复切换
+    if (degraded_.load() && ring_.size() < ring_.capacity() / 2
+        && bytes_.loadAcquire() < byteBudget_ / 2 && degraded_.testAndSetOrdered(1, 0))
+        qCInfo(lcRec) << "[REC] Recording recovered, dropped so far:" << dropped();
+    return true;
+}
+
+bool RecordQueue::pop(Item& out)
+{
+    if (!ring_.pop(out)) return false;
+    bytes_.fetchAndSubRelaxed(out.frame.size());
+    return true;
+}
+
+Recorder::Recorder(const QString& dir, QObject* parent)
+    : QThread(parent), dir_(dir)
+{
+    setObjectName("hub-rec");
+}
+
+Recorder::~Recorder()
+{
+    shutdown();
+    qDeleteAll(queues_);
+}
+
+bool Recorder::open()
+{
+    if (isRunning()) return true;
+    if (!QDir().mkpath(dir_)) {
+        qCWarning(lcRec) << "[REC] Cannot create recording directory" << dir_;
+        return false;
+    }
+    start();
+    qCInfo(lcRec) << "[REC] Recording to" << QDir(dir_).absolutePath();
+    return true;
+}
+
+void Recorder::shutdown()
+{
+    if (!isRunning()) return;
+    stopping_.storeRelease(1);
+    wait();
+    qCInfo(lcRec) << "[REC] Stopped:" << QJsonDocument(stats()).toJson(QJsonDocument::Compact);
+}
+
+RecordQueue* Recorder::createQueue()
+{
+    auto* q = new RecordQueue(kQueueCapacity, kQueueBytes);
+    QMutexLocker lock(&mutex_);
+    queues_.append(q);
+    return q;
+}
+
+QJsonObject Recorder::stats() const
+{
+    quint64 dropped = 0;
+    int degraded = 0;
+    {
+        QMutexLocker lock(&mutex_);
+        for (const RecordQueue* q : queues_) {
+            dropped += q->dropped();
+            if (q->degraded()) ++degraded;
+        }
+    }
+    return QJsonObject{
+        {"records", double(records_.loadAcquire())},
+        {"bytes", double(bytes_.loadAcquire())},
+        {"dropped", double(dropped)},
+        {"degradedQueues", degraded},
+        {"writeErrors", double(writeErrors_.loadAcquire())}
+    };
+}
+
+void Recorder::run()
+{
+    QElapsedTimer clock;
+    clock.start();
+    qint64 lastFlush = 0;
+    qint64 lastSync = 0;
+    for (;;) {
+        QVector<RecordQueue*> queues;
+        {
+            QMutexLocker lock(&mutex_);
+            queues = queues_;
+        }
+        const bool stopping = stopping_.loadAcquire();
+        const int n = drain(queues);
+
+        const qint64 now = clock.elapsed();
+        if (now - lastFlush >= kFlushIntervalMs) {
+            const bool sync = now - lastSync >= kSyncIntervalMs;
+            flushAll(sync);
+            closeIdle();
+            lastFlush = now;
+            if (sync) lastSync = now;
+        }
+        // 先读停止标志再排空：停止前入队的条目都已写出
+        if (stopping && n == 0) break;
+        if (n == 0)
+            QThread::msleep(2);
+    }
+
+    for (Sink& sink : sinks_)
+        delete sink.writer; // close() 写出剩余数据并同步
+    sinks_.clear();
+}
+
+int Recorder::drain(const QVector<RecordQueue*>& queues)
+{
+    int total = 0;
+    RecordQueue::Item item;
+    for (RecordQueue* q : queues) {
+        for (int i = 0; i < kDrainPerQueue && q->pop(item); ++i) {
+            append(item);
+            ++total;
+        }
+    }
+    item = RecordQueue::Item();
+    return total;
+}
+
+void Recorder::append(const RecordQueue::Item& item)
+{
+    auto it = sinks_.find(item.ticket);
+    if (it == sinks_.end()) {
+        Sink sink;
+        sink.writer = new SegmentWriter(pathFor(item.ticket));
+        it = sinks_.insert(item.ticket, sink);
+    }
+
+    Sink& sink = *it;
+    sink.lastMs = item.ms;
+    if (!sink.writer->append(item.ms, item.frame)) {
+        static LogThrottle openLog(5000);
+        if (openLog.allow())
+            qCWarning(lcRec) << "[REC] Cannot open segment in" << pathFor(item.ticket);
+        writeErrors_.fetchAndAddRelaxed(1);
+        return;
+    }
+    records_.fetchAndAddRelaxed(1);
+    bytes_.fetchAndAddRelaxed(quint64(item.frame.size()));
+    if (sink.writer->pendingBytes() >= kBatchBytes)
+        flush(sink);
+}
+
+// 一次 write 写出该工单积压的全部记录（段数据与索引各一次）
+void Recorder::flush(Sink& sink)
+{
+    if (!sink.writer->flush()) {
+        static LogThrottle writeLog(5000);
+        if (writeLog.allow())
+            qCWarning(lcRec) << "[REC] Write failed in" << sink.writer->directory();
+        writeErrors_.fetchAndAddRelaxed(1);
+    }
+}
+
+// group commit：本周期写过的文件各 fdatasync 一次
+void Recorder::flushAll(bool sync)
+{
+    for (Sink& sink : sinks_) {
+        flush(sink);
+        if (sync && !sink.writer->sync())
+            writeErrors_.fetchAndAddRelaxed(1);
+    }
+}
+
+void Recorder::closeIdle()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (auto it = sinks_.begin(); it != sinks_.end();) {
+        if (now - it->lastMs >= kIdleCloseMs) {
+            delete it->writer;
+            it = sinks_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// 工单号来自客户端：百分号编码后作为目录名，路径分隔符与 '.' 都被编码（"." / ".." 不会指向录制根目录或其上级）；
+// 空工单号映射为 "%"（编码结果不会单独出现 '%'）
+QString Recorder::pathFor(const QString& ticket) const
+{
+    if (ticket.isEmpty()) return dir_ + QStringLiteral("/%");
+    return dir_ + '/' + QString::fromLatin1(QUrl::toPercentEncoding(ticket, QByteArray(), "."));
+}
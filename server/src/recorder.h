@@ -0,0 +1,97 @@
+#pragma once
+// ===============================================
+// server/src/recorder.h
+// 工单会话录制：转发线程只入队，写线程批量顺序追加 + 定期 fdatasync（group commit）
+// - 每个 RoomHub 一个 RecordQueue（单生产者/单消费者无锁队列），入队不加锁、不复制负载：
+//   条目持有接收块的引用（同 EgressQueue 的 keepAlive），写线程写完后释放
+// - 队列满或积压字节超限时丢弃并计数，进入“录制降级”状态（限频告警），积压降到一半以下后恢复；
+//   转发从不等待磁盘
+// - 写线程按工单分别缓冲，凑满 kBatchBytes 或每 kFlushIntervalMs 一次 write，
+//   每 kSyncIntervalMs 对写过的文件 fdatasync 一次，空闲工单自动关闭
+// 磁盘格式（分段 + 时间索引）见 recording.h：<dir>/<ticket>/<baseMs>.seg|.idx
+// ===============================================
+#include <QtCore>
+#include "spscqueue.h"
+#include "recording.h"
+
+struct Packet;
+
+class RecordQueue
+{
+public:
+    struct Item {
+        QString ticket;
+        qint64 ms = 0;
+        QByteArray frame;      // 原始帧（keepAlive 的视图）
+        QByteArray keepAlive;  // 帧所在的接收块
+    };
+
+    // 转发线程调用：返回 false 表示已丢弃（降级）
+    bool push(const QString& ticket, const Packet& p);
+
+    bool degraded() const { return degraded_.loadAcquire() != 0; }
+    quint64 dropped() const { return dropped_.loadAcquire(); }
+
+private:
+    friend class Recorder;
+    RecordQueue(int capacity, qint64 byteBudget) : ring_(capacity), byteBudget_(byteBudget) {}
+    bool pop(Item& out);
+
+    SpscQueue<Item> ring_;
+    const qint64 byteBudget_;
+    QAtomicInteger<qint64> bytes_{0};   // 队列中帧的总字节数
+    QAtomicInteger<quint64> dropped_{0};
+    QAtomicInt degraded_{0};
+};
+
+class Recorder : public QThread
+{
+public:
+    explicit Recorder(const QString& dir, QObject* parent = nullptr);
+    ~Recorder() override;
+
+    // 创建目录并启动写线程
+    bool open();
+    // 写出全部积压、同步到磁盘后停止（程序退出前调用）
+    void shutdown();
+
+    // 为一个生产者（RoomHub）创建队列；队列归 Recorder 所有
+    RecordQueue* createQueue();
+
+    // 录制统计：已写记录/字节、丢弃数、降级中的队列数
+    QJsonObject stats() const;
+    // 工单的录制目录（回放时用，见 RecordingReader）
+    QString pathFor(const QString& ticket) const;
+
+protected:
+    void run() override;
+
+private:
+    struct Sink {
+        SegmentWriter* writer = nullptr;
+        qint64 lastMs = 0;    // 最后一条记录的时间（空闲关闭用）
+    };
+
+    static const int kQueueCapacity = 4096;
+    static const qint64 kQueueBytes = 64 * 1024 * 1024;
+    static const int kBatchBytes = 1024 * 1024;
+    static const int kFlushIntervalMs = 50;
+    static const int kSyncIntervalMs = 1000;
+    static const int kIdleCloseMs = 30000;
+
+    int drain(const QVector<RecordQueue*>& queues);
+    void append(const RecordQueue::Item& item);
+    void flush(Sink& sink);
+    void flushAll(bool sync);
+    void closeIdle();
+
+    const QString dir_;
+    mutable QMutex mutex_;              // 保护 queues_ 的增删
+    QVector<RecordQueue*> queues_;
+    QAtomicInt stopping_{0};
+    QHash<QString, Sink> sinks_;        // 仅写线程访问
+
+    QAtomicInteger<quint64> records_{0};
+    QAtomicInteger<quint64> bytes_{0};
+    QAtomicInteger<quint64> writeErrors_{0};
+};
@@ -0,0 +1,335 @@
+#include "recording.h"
+#include <algorithm>
+#include <cstring>
+#include "../../common/protocol.h"
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+static const char kSegmentMagic[] = "RXSEG001";
+static const char kIndexMagic[] = "RXIDX001";
+static const int kHeaderSize = 16;      // 8B magic + i64 baseMs
+static const int kEntrySize = 8;        // u32 时间差 + u32 段内偏移
+static const int kRecordPrefix = 4;     // 记录前的 u32 时间差
+static const int kFrameLenSize = 4;     // 帧的 u32 length（不含自身）
+static const int kMinFrameBody = 6;     // type + jsonSize
+static const qint64 kReleaseChunk = 8 * 1024 * 1024; // 顺序回放时每读过这么多字节释放一次页面
+
+static QByteArray fileHeader(const char* magic, qint64 baseMs)
+{
+    QByteArray h(magic, 8);
+    h.resize(kHeaderSize);
+    qToBigEndian<qint64>(baseMs, reinterpret_cast<uchar*>(h.data()) + 8);
+    return h;
+}
+
+static bool checkHeader(const uchar* p, const char* magic, qint64* baseMs)
+{
+    if (memcmp(p, magic, 8) != 0) return false;
+    *baseMs = qFromBigEndian<qint64>(p + 8);
+    return true;
+}
+
+// 文件名：13位补零的毫秒时间，字典序即时间序
+static QString segmentName(qint64 baseMs, const char* suffix)
+{
+    return QString("%1.%2").arg(baseMs, 13, 10, QChar('0')).arg(QLatin1String(suffix));
+}
+
+// 把已写出的数据落盘（只同步数据，不强制更新元数据）
+static bool syncFile(QFile& file)
+{
+#if defined(Q_OS_LINUX)
+    return ::fdatasync(file.handle()) == 0;
+#elif defined(Q_OS_UNIX)
+    return ::fsync(file.handle()) == 0;
+#else
+    return file.flush();
+#endif
+}
+
+// offset 处是否有一条完整的记录
+static bool recordFits(const uchar* data, qint64 size, qint64 offset)
+{
+    if (offset + kRecordPrefix + kFrameLenSize > size) return false;
+    const quint32 len = qFromBigEndian<quint32>(data + offset + kRecordPrefix);
+    return len >= quint32(kMinFrameBody) && offset + kRecordPrefix + kFrameLenSize + qint64(len) <= size;
+}
+
+static void appendU32(QByteArray& out, quint32 v)
+{
+    const quint32 be = qToBigEndian(v);
+    out.append(reinterpret_cast<const char*>(&be), sizeof(be));
+}
+
+// ---------------- SegmentWriter ----------------
+
+bool SegmentWriter::append(qint64 ms, const QByteArray& frame)
+{
+    const qint64 recordSize = kRecordPrefix + frame.size();
+    if (!seg_.isOpen()
+        || (segSize_ > kHeaderSize && segSize_ + recordSize > kSegmentBytes)
+        || ms - baseMs_ >= kSegmentMs) {
+        const qint64 base = qMax(ms, lastMs_);
+        close();
+        if (!openSegment(base)) return false;
+    }
+
+    ms = qMax(ms, lastMs_);
+    lastMs_ = ms;
+    const quint32 delta = quint32(ms - baseMs_);
+    appendU32(index_, delta);
+    appendU32(index_, quint32(segSize_));
+    appendU32(data_, delta);
+    data_.append(frame);
+    segSize_ += recordSize;
+    return true;
+}
+
+bool SegmentWriter::openSegment(qint64 baseMs)
+{
+    QDir dir(dir_);
+    if (!dir.mkpath(".")) return false;
+    // 同一毫秒内重新打开（空闲关闭后又有数据）时顺延，不覆盖已有的段
+    while (dir.exists(segmentName(baseMs, "seg")))
+        ++baseMs;
+    seg_.setFileName(dir.filePath(segmentName(baseMs, "seg")));
+    idx_.setFileName(dir.filePath(segmentName(baseMs, "idx")));
+    if (!seg_.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) return false;
+    if (!idx_.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        seg_.close();
+        return false;
+    }
+    baseMs_ = baseMs;
+    lastMs_ = baseMs;
+    data_ = fileHeader(kSegmentMagic, baseMs);
+    index_ = fileHeader(kIndexMagic, baseMs);
+    segSize_ = kHeaderSize;
+    return true;
+}
+
+// 先写段数据再写索引：索引项不会指向尚未写出的数据
+bool SegmentWriter::flush()
+{
+    if (!seg_.isOpen() || data_.isEmpty()) return true;
+    bool ok = seg_.write(data_) == data_.size();
+    ok = ok && idx_.write(index_) == index_.size();
+    if (ok) bytesWritten_ += data_.size();
+    dirty_ = true;
+    data_.resize(0);  // 保留容量
+    index_.resize(0);
+    return ok;
+}
+
+bool SegmentWriter::sync()
+{
+    if (!dirty_) return true;
+    dirty_ = false;
+    const bool segOk = syncFile(seg_);
+    return syncFile(idx_) && segOk;
+}
+
+void SegmentWriter::close()
+{
+    if (!seg_.isOpen()) return;
+    flush();
+    sync();
+    seg_.close();
+    idx_.close();
+    data_.clear();
+    index_.clear();
+}
+
+// ---------------- RecordingReader ----------------
+
+RecordingReader::Entry RecordingReader::Segment::entry(int i) const
+{
+    if (i < indexed) {
+        const uchar* p = indexMap + kHeaderSize + qint64(i) * kEntrySize;
+        return Entry{ qFromBigEndian<quint32>(p), qFromBigEndian<quint32>(p + 4) };
+    }
+    return tail.at(i - indexed);
+}
+
+bool RecordingReader::open(const QString& ticketDir)
+{
+    close();
+    QDir dir(ticketDir);
+    const QStringList segs = dir.entryList(QStringList() << "*.seg", QDir::Files, QDir::Name);
+    if (segs.isEmpty()) {
+        error_ = QString("no segments in %1").arg(ticketDir);
+        return false;
+    }
+    for (const QString& name : segs) {
+        const QString base = name.left(name.size() - 4);
+        if (!openSegment(dir.filePath(name), dir.filePath(base + ".idx"))) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RecordingReader::openSegment(const QString& segPath, const QString& idxPath)
+{
+    Segment s;
+    s.seg = new QFile(segPath);
+    if (!s.seg->open(QIODevice::ReadOnly) || s.seg->size() < kHeaderSize
+        || !(s.data = s.seg->map(0, s.seg->size()))
+        || !checkHeader(s.data, kSegmentMagic, &s.baseMs)) {
+        error_ = QString("bad segment %1").arg(segPath);
+        delete s.seg;
+        return false;
+    }
+    s.size = s.seg->size();
+
+    // 索引缺失或损坏时整段靠扫描补齐
+    s.idx = new QFile(idxPath);
+    qint64 idxBase = 0;
+    if (s.idx->open(QIODevice::ReadOnly) && s.idx->size() >= kHeaderSize
+        && (s.indexMap = s.idx->map(0, s.idx->size()))
+        && checkHeader(s.indexMap, kIndexMagic, &idxBase) && idxBase == s.baseMs) {
+        s.indexed = int((s.idx->size() - kHeaderSize) / kEntrySize);
+        // 指向段外的索引项（数据写出不完整）丢弃
+        while (s.indexed > 0 && !recordFits(s.data, s.size, s.entry(s.indexed - 1).offset))
+            --s.indexed;
+    } else {
+        s.indexed = 0;
+    }
+    scanTail(s);
+    segments_.append(s);
+    return true;
+}
+
+// 从最后一个索引项之后顺序扫描到段尾（记录自带长度），截断的末尾记录忽略
+void RecordingReader::scanTail(Segment& s)
+{
+    qint64 off = kHeaderSize;
+    if (s.indexed > 0) {
+        const Entry last = s.entry(s.indexed - 1);
+        off = last.offset + kRecordPrefix + kFrameLenSize
+            + qFromBigEndian<quint32>(s.data + last.offset + kRecordPrefix);
+    }
+    quint32 lastDelta = s.indexed > 0 ? s.entry(s.indexed - 1).delta : 0;
+    while (recordFits(s.data, s.size, off)) {
+        const quint32 delta = qFromBigEndian<quint32>(s.data + off);
+        if (delta < lastDelta) break;
+        s.tail.append(Entry{ delta, quint32(off) });
+        lastDelta = delta;
+        off += kRecordPrefix + kFrameLenSize + qFromBigEndian<quint32>(s.data + off + kRecordPrefix);
+    }
+}
+
+void RecordingReader::close()
+{
+    for (Segment& s : segments_) {
+        if (s.data) s.seg->unmap(s.data);
+        if (s.indexMap) s.idx->unmap(s.indexMap);
+        delete s.seg;
+        delete s.idx;
+    }
+    segments_.clear();
+}
+
+quint64 RecordingReader::recordCount() const
+{
+    quint64 n = 0;
+    for (const Segment& s : segments_) n += quint64(s.entries());
+    return n;
+}
+
+qint64 RecordingReader::firstMs() const
+{
+    for (const Segment& s : segments_)
+        if (s.entries() > 0) return s.baseMs + s.entry(0).delta;
+    return 0;
+}
+
+qint64 RecordingReader::lastMs() const
+{
+    for (int i = segments_.size() - 1; i >= 0; --i) {
+        const Segment& s = segments_.at(i);
+        if (s.entries() > 0) return s.baseMs + s.entry(s.entries() - 1).delta;
+    }
+    return 0;
+}
+
+RecordingReader::Cursor RecordingReader::seek(qint64 ms) const
+{
+    Cursor c;
+    if (segments_.isEmpty()) return c;
+    // 最后一个 baseMs <= ms 的段：目标记录在该段或其后的段中
+    auto it = std::upper_bound(segments_.constBegin(), segments_.constEnd(), ms,
+                               [](qint64 t, const Segment& s) { return t < s.baseMs; });
+    c.segment = it == segments_.constBegin() ? 0 : int(it - segments_.constBegin()) - 1;
+
+    const Segment& s = segments_.at(c.segment);
+    const qint64 target = ms - s.baseMs;
+    int lo = 0, hi = s.entries();
+    while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+        if (qint64(s.entry(mid).delta) < target) lo = mid + 1;
+        else hi = mid;
+    }
+    c.entry = lo;
+    // 本段之内没有 >= ms 的记录：跳到后续第一个非空段
+    while (c.segment < segments_.size() && c.entry >= segments_.at(c.segment).entries()) {
+        ++c.segment;
+        c.entry = 0;
+    }
+    return c;
+}
+
+bool RecordingReader::next(Cursor& c, qint64* ms, QByteArray* frame) const
+{
+    while (c.segment < segments_.size() && c.entry >= segments_.at(c.segment).entries()) {
+        if (streaming_) release(segments_.at(c.segment), segments_.at(c.segment).size);
+        ++c.segment;
+        c.entry = 0;
+    }
+    if (atEnd(c)) return false;
+
+    const Segment& s = segments_.at(c.segment);
+    const Entry e = s.entry(c.entry++);
+    if (streaming_ && e.offset - s.released >= kReleaseChunk)
+        release(s, e.offset);
+    const uchar* p = s.data + e.offset;
+    const quint32 len = qFromBigEndian<quint32>(p + kRecordPrefix);
+    if (ms) *ms = s.baseMs + e.delta;
+    if (frame)
+        *frame = QByteArray::fromRawData(reinterpret_cast<const char*>(p + kRecordPrefix),
+                                         int(kFrameLenSize + len));
+    return true;
+}
+
+void RecordingReader::setStreaming(bool on)
+{
+    streaming_ = on;
+#ifdef Q_OS_UNIX
+    for (const Segment& s : segments_)
+        ::posix_madvise(s.data, size_t(s.size), on ? POSIX_MADV_SEQUENTIAL : POSIX_MADV_NORMAL);
+#endif
+}
+
+// 释放 [released, upTo) 中整页的映射（文件页只是解除映射，再次访问时从页缓存/磁盘重新读入）
+void RecordingReader::release(const Segment& s, qint64 upTo) const
+{
+#ifdef Q_OS_UNIX
+    static const qint64 page = ::sysconf(_SC_PAGESIZE);
+    const qint64 end = upTo / page * page;
+    if (end <= s.released) return;
+    ::madvise(s.data + s.released, size_t(end - s.released), MADV_DONTNEED);
+    s.released = end;
+#else
+    Q_UNUSED(s);
+    Q_UNUSED(upTo);
+#endif
+}
+
+quint16 RecordingReader::frameType(const QByteArray& frame)
+{
+    if (frame.size() < kFrameLenSize + 2) return 0;
+    const quint16 raw = qFromBigEndian<quint16>(reinterpret_cast<const uchar*>(frame.constData()) + kFrameLenSize);
+    return raw & ~(kTypeCborFlag | kTypeFragmentFlag);
+}
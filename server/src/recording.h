@@ -0,0 +1,121 @@
+#pragma once
+// ===============================================
+// server/src/recording.h
+// 会话录制的磁盘格式：按工单分目录，只追加、分段，每段带紧凑的 时间戳 -> 偏移 索引
+//
+//   <dir>/<ticket>/<baseMs>.seg   段文件：16B 头（magic "RXSEG001" + i64 baseMs）
+//                                  之后每条记录为 [u32 ms-baseMs][完整帧]（帧自带长度，见 protocol.h）
+//   <dir>/<ticket>/<baseMs>.idx   索引：16B 头（magic "RXIDX001" + i64 baseMs）
+//                                  之后每条记录一项 [u32 ms-baseMs][u32 段内偏移]，按时间单调不减
+// 多字节整数均为大端；文件名中的 baseMs 补零到13位，按名字排序即按时间排序。
+// 段在超过 kSegmentBytes 或 kSegmentMs 时切换（保证 u32 偏移/时间差不溢出）。
+// 索引在段数据之后写出：崩溃后索引可能落后，读取时从最后一个索引项向后扫描补齐。
+//
+// SegmentWriter 由录制线程使用（见 Recorder）；RecordingReader 以 mmap 只读打开，
+// 按时间定位为两次二分查找（先段、后段内索引），O(log n)，不扫描数据。
+// ===============================================
+#include <QtCore>
+
+// 单个工单目录的写入端（只在录制线程中使用）
+class SegmentWriter
+{
+public:
+    static const qint64 kSegmentBytes = 256LL * 1024 * 1024;
+    static const qint64 kSegmentMs = 3600LL * 1000;
+
+    explicit SegmentWriter(const QString& ticketDir) : dir_(ticketDir) {}
+    ~SegmentWriter() { close(); }
+
+    // 追加一条记录到内存缓冲；需要时先切换到新段。时间戳比上一条小时按上一条记（索引保持单调）
+    bool append(qint64 ms, const QByteArray& frame);
+    // 把缓冲写入段文件与索引文件（各一次 write）
+    bool flush();
+    // fdatasync 本次同步以来写过的文件（group commit）
+    bool sync();
+    void close();
+
+    qint64 pendingBytes() const { return data_.size(); }
+    bool dirty() const { return dirty_; }
+    qint64 bytesWritten() const { return bytesWritten_; }
+    QString directory() const { return dir_; }
+
+private:
+    bool openSegment(qint64 baseMs);
+
+    const QString dir_;
+    QFile seg_;
+    QFile idx_;
+    QByteArray data_;          // 待写出的记录
+    QByteArray index_;         // 待写出的索引项
+    qint64 baseMs_ = 0;
+    qint64 lastMs_ = 0;
+    qint64 segSize_ = 0;       // 段文件逻辑大小（含未写出的缓冲）
+    qint64 bytesWritten_ = 0;
+    bool dirty_ = false;
+};
+
+// 只读回放：mmap 工单目录下的全部段
+class RecordingReader
+{
+public:
+    // 读取位置：段号 + 段内记录序号
+    struct Cursor {
+        int segment = 0;
+        int entry = 0;
+    };
+
+    RecordingReader() = default;
+    ~RecordingReader() { close(); }
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    bool open(const QString& ticketDir);
+    void close();
+    QString errorString() const { return error_; }
+
+    int segmentCount() const { return segments_.size(); }
+    quint64 recordCount() const;
+    qint64 firstMs() const;
+    qint64 lastMs() const;
+
+    // 第一条时间 >= ms 的记录位置（ms 超过末尾时返回 atEnd 的位置）
+    Cursor seek(qint64 ms) const;
+    bool atEnd(const Cursor& c) const { return c.segment >= segments_.size(); }
+    // 读出当前记录并前进；frame 是映射内存的视图（reader 存活期间有效，不复制）
+    bool next(Cursor& c, qint64* ms, QByteArray* frame) const;
+
+    // 顺序回放：提示内核顺序预读，并把已读过的页面逐步从映射中释放，长录制回放时常驻内存有界
+    void setStreaming(bool on);
+
+    // 帧的消息类型（去掉编码/分片标记位）
+    static quint16 frameType(const QByteArray& frame);
+
+private:
+    struct Entry {
+        quint32 delta;
+        quint32 offset;
+    };
+    struct Segment {
+        QFile* seg = nullptr;
+        QFile* idx = nullptr;
+        uchar* data = nullptr;         // 段文件映射
+        qint64 size = 0;
+        uchar* indexMap = nullptr;     // 索引文件映射（索引项从 16B 头之后开始）
+        int indexed = 0;               // 索引文件中的项数
+        QVector<Entry> tail;           // 索引之后扫描补齐的项（崩溃或正在写入的段）
+        qint64 baseMs = 0;
+        mutable qint64 released = 0;   // 顺序回放时已释放的页面范围 [0, released)
+
+        int entries() const { return indexed + tail.size(); }
+        Entry entry(int i) const;
+    };
+
+    bool openSegment(const QString& segPath, const QString& idxPath);
+    static void scanTail(Segment& s);
+
+    void release(const Segment& s, qint64 upTo) const;
+
+    QVector<Segment> segments_;
+    QString error_;
+    bool streaming_ = false;
+};
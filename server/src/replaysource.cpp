@@ -0,0 +1,116 @@
+#include "replaysource.h"
+#include "../../common/protocol.h"
+#include <cmath>
+
+constexpr double ReplaySource::kMinSpeed;
+constexpr double ReplaySource::kMaxSpeed;
+
+ReplaySource::ReplaySource(QObject* parent) : QObject(parent)
+{
+    timer_.setSingleShot(true);
+    timer_.setTimerType(Qt::PreciseTimer);
+    connect(&timer_, &QTimer::timeout, this, &ReplaySource::tick);
+    clock_.start();
+}
+
+bool ReplaySource::open(const QString& ticketDir)
+{
+    if (!reader_.open(ticketDir)) return false;
+    reader_.setStreaming(true);
+    seek(0);
+    return true;
+}
+
+bool ReplaySource::isReplayType(quint16 type)
+{
+    return type == MSG_VIDEO_FRAME || type == MSG_AUDIO_FRAME || type == MSG_DEVICE_DATA;
+}
+
+void ReplaySource::start()
+{
+    if (playing_) return;
+    rebase(anchorRecMs_);
+    playing_ = true;
+    timer_.start(0);
+}
+
+void ReplaySource::pause()
+{
+    if (!playing_) return;
+    rebase(recordingNow());
+    playing_ = false;
+    timer_.stop();
+}
+
+void ReplaySource::seek(qint64 offsetMs)
+{
+    const qint64 target = reader_.firstMs() + qBound<qint64>(0, offsetMs, durationMs());
+    cursor_ = reader_.seek(target);
+    ++generation_;
+    havePending_ = false;
+    pendingFrame_.clear();
+    rebase(target);
+    if (playing_) timer_.start(0);
+}
+
+void ReplaySource::setSpeed(double speed)
+{
+    const double s = qBound(kMinSpeed, speed, kMaxSpeed);
+    rebase(recordingNow());
+    ++generation_;
+    speed_ = s;
+    if (playing_) timer_.start(0);
+}
+
+// 当前对应的录制时间：暂停时停在锚点，播放时按速度随墙钟推进
+qint64 ReplaySource::recordingNow() const
+{
+    if (!playing_) return anchorRecMs_;
+    return anchorRecMs_ + qint64((clock_.elapsed() - anchorWallMs_) * speed_);
+}
+
+void ReplaySource::rebase(qint64 recordingMs)
+{
+    anchorRecMs_ = recordingMs;
+    anchorWallMs_ = clock_.elapsed();
+}
+
+// 读出下一条要回放的帧（跳过不回放的类型）
+bool ReplaySource::peek()
+{
+    while (!havePending_) {
+        if (!reader_.next(cursor_, &pendingMs_, &pendingFrame_)) return false;
+        pendingType_ = RecordingReader::frameType(pendingFrame_);
+        havePending_ = isReplayType(pendingType_);
+    }
+    return true;
+}
+
+void ReplaySource::tick()
+{
+    if (!playing_) return;
+    const quint64 generation = generation_;
+    const qint64 due = recordingNow();
+    for (int n = 0; n < kMaxBurst; ++n) {
+        if (!peek()) {
+            if (loop_ && reader_.recordCount() > 0) {
+                seek(0);
+                return;
+            }
+            playing_ = false;
+            emit finished();
+            return;
+        }
+        if (pendingMs_ > due) {
+            // 等到下一帧的原始时间（按速度折算）
+            timer_.start(int(std::ceil((pendingMs_ - due) / speed_)));
+            return;
+        }
+        havePending_ = false;
+        const QByteArray frame = pendingFrame_;
+        pendingFrame_.clear();
+        emit packet(pendingType_, frame);
+        if (!playing_ || generation != generation_) return; // 槽函数中暂停、定位或变速
+    }
+    timer_.start(0);
+}
@@ -0,0 +1,73 @@
+#pragma once
+// ===============================================
+// server/src/replaysource.h
+// 录制回放源：从工单录制目录（见 recording.h）顺序读出视频/音频/设备数据帧，
+// 按原始的包间隔、以 1×–16× 速度在当前线程的事件循环中逐条发出
+// - 读取经 mmap 流式进行，已读过的页面随回放释放；任何时刻只持有下一条待发的帧（映射视图），内存有界
+// - 支持暂停、定位（相对录制开始的毫秒数）、变速、循环
+// - 服务器用它把历史会话注入房间（MSG_REPLAY_CONTROL），loadgen 用它作为确定性的压测流量（--replay）
+// ===============================================
+#include <QtCore>
+#include "recording.h"
+
+class ReplaySource : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr double kMinSpeed = 1.0;
+    static constexpr double kMaxSpeed = 16.0;
+
+    explicit ReplaySource(QObject* parent = nullptr);
+
+    bool open(const QString& ticketDir);
+    QString errorString() const { return reader_.errorString(); }
+
+    void start();
+    void pause();
+    bool isPlaying() const { return playing_; }
+    // 定位到录制开始后 offsetMs 处（播放中则从该处继续）
+    void seek(qint64 offsetMs);
+    // 速度限制在 [kMinSpeed, kMaxSpeed]
+    void setSpeed(double speed);
+    double speed() const { return speed_; }
+    // 播完后从头开始（压测用）
+    void setLoop(bool on) { loop_ = on; }
+
+    qint64 durationMs() const { return reader_.lastMs() - reader_.firstMs(); }
+    qint64 positionMs() const { return recordingNow() - reader_.firstMs(); }
+
+    // 回放的消息类型：视频、音频、设备数据（聊天/控制不回放）
+    static bool isReplayType(quint16 type);
+
+signals:
+    // frame 为完整帧，是映射文件的视图，只在本次调用期间有效；需要保留时请深拷贝
+    void packet(quint16 type, const QByteArray& frame);
+    void finished();
+
+private slots:
+    void tick();
+
+private:
+    bool peek();
+    qint64 recordingNow() const;
+    void rebase(qint64 recordingMs);
+
+    static const int kMaxBurst = 256; // 一次最多发出的帧数（追赶时让出事件循环）
+
+    RecordingReader reader_;
+    RecordingReader::Cursor cursor_;
+    QTimer timer_;
+    QElapsedTimer clock_;
+    qint64 anchorRecMs_ = 0;    // 锚点：录制时间
+    qint64 anchorWallMs_ = 0;   // 锚点：clock_ 时间
+    double speed_ = 1.0;
+    bool playing_ = false;
+    bool loop_ = false;
+    quint64 generation_ = 0;    // 定位/变速时递增，tick 中据此放弃过期的批次
+
+    // 下一条待发的帧
+    bool havePending_ = false;
+    qint64 pendingMs_ = 0;
+    quint16 pendingType_ = 0;
+    QByteArray pendingFrame_;
+};
@@ -0,0 +1,36 @@
+#pragma once
+// ===============================================
+// server/src/roomdirectory.h
+// 多worker模式下的房间归属表：roomId -> 拥有该房间的 RoomHub（worker）
+// 同一房间的成员都在同一个worker线程内，房间内转发无需加锁；只有加入/离开时访问本表
+// ===============================================
+#include <QtCore>
+
+class RoomHub;
+
+class RoomDirectory
+{
+public:
+    // 返回房间的拥有者；房间尚无拥有者时登记为 candidate
+    RoomHub* claim(const QString& roomId, RoomHub* candidate)
+    {
+        QMutexLocker lock(&mutex_);
+        auto it = owners_.find(roomId);
+        if (it == owners_.end())
+            it = owners_.insert(roomId, candidate);
+        return it.value();
+    }
+
+    // 房间变空时由拥有者释放（仍是拥有者才生效）
+    void release(const QString& roomId, RoomHub* owner)
+    {
+        QMutexLocker lock(&mutex_);
+        auto it = owners_.find(roomId);
+        if (it != owners_.end() && it.value() == owner)
+            owners_.erase(it);
+    }
+
+private:
+    QMutex mutex_;
+    QHash<QString, RoomHub*> owners_;
+};
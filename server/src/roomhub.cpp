@@ -1,164 +1,295 @@
 ﻿#include "roomhub.h"
+#include "logging.h"
+#include "dbworker.h"
+#include "sessionstore.h"
+#include "recorder.h"
+#include "replaysource.h"
+#include "timeseries.h"
+#include <cstring>
 
-RoomHub::RoomHub(QObject* parent) : QObject(parent),dbManager_(DatabaseManager::instance()){}
+// 每连接内核发送缓冲上限（局域网下足够跑满视频，同时让控制指令的排队延迟保持在毫秒级）
+static const int kKernelSendBuffer = 256 * 1024;
+// 发送队列丢帧的定期报告间隔
+static const int kEgressReportMs = 10 * 1000;
+
+// 直通转发的分片流在接收方连接上的 stream id（全局递增，来自不同发送方的流不会冲突）
+static QAtomicInteger<quint32> s_relayStreamIds;
+// 每个发送方同时直通转发的分片流上限（异常的未完成流不会无限累积）
+static const int kMaxRelayStreams = 16;
+// 每个房间为断线重连保留的聊天条数上限
+static const int kChatHistory = 256;
+// 新成员快照：聊天条数、缓存视频的发送方数、单帧大小、设备指标数的上限
+static const int kSnapshotChat = 50;
+static const int kSnapshotVideoSenders = 16;
+static const int kSnapshotMaxFrame = 2 * 1024 * 1024;
+static const int kSnapshotDevices = 512;
+// 设备历史查询缺省的时间范围与点数
+static const qint64 kDeviceQueryDefaultMs = 3600 * 1000;
+static const int kDeviceQueryDefaultPoints = 1000;
+// 查询时间戳的上限（2100-01-01）：跨度以秒计时仍放得进 u32 偏移
+static const qint64 kDeviceQueryMaxMs = 4102444800000LL;
+
+// 连接记录池（进程级，所有worker共用；迁移过来的连接由目标worker释放）
+static SlabPool<ClientCtx>& clientPool()
+{
+    static SlabPool<ClientCtx> pool;
+    return pool;
+}
+
+RoomHub::RoomHub(const QString& transport, QObject* parent) : QObject(parent),
+    transport_(Transport::create(transport, this))
+{
+    if (!transport_)
+    {
+        qCWarning(lcServer) << "不支持的传输层" << transport << "，改用qt";
+        transport_ = Transport::create(QStringLiteral("qt"), this);
+    }
+    // 当有新连接时，调用onNewConnection处理
+    connect(transport_, &Transport::newConnection, this, &RoomHub::onNewConnection);
+    egressReport_ = new QTimer(this);
+    egressReport_->setInterval(kEgressReportMs);
+    connect(egressReport_, &QTimer::timeout, this, &RoomHub::reportEgress);
+}
 RoomHub::~RoomHub(){}
 
+void RoomHub::setRecorder(Recorder* recorder)
+{
+    recorder_ = recorder;
+    record_ = recorder ? recorder->createQueue() : nullptr;
+}
+
 //Part 1.Tcp Server Manage
 // 实现监听功能
 bool RoomHub::startListening(const QHostAddress &address, quint16 port)
 {
-    return server_.listen(address, port);
+    return transport_->listen(address, port);
 }
 
 // 实现错误信息获取
 QString RoomHub::lastError() const
 {
-    return server_.errorString();
+    return transport_->errorString();
 }
 
 QHostAddress RoomHub::serverAddress() const
 {
-    return server_.serverAddress();
+    return transport_->serverAddress();
 }
 
 // 启动服务器，开始监听指定端口port
 bool RoomHub::start(quint16 port)
 {
-    if(!dbManager_.initialize())
+    if(!DbWorker::instance().start())
     {
-        qCritical()<<"Failed to initialize database!";
+        qCCritical(lcServer)<<"Failed to initialize database!";
         return false;
     }
 
-    // 当有新连接时，调用onNewConnection处理
-    connect(&server_, &QTcpServer::newConnection, this, &RoomHub::onNewConnection);
-
     // QHostAddress::Any表示监听所有可用的网络接口
-    if (!server_.listen(QHostAddress::Any, port))
+    if (!transport_->listen(QHostAddress::Any, port))
     {
-        qWarning() << "端口" << port << "监听失败:" << server_.errorString();
+        qCWarning(lcServer) << "端口" << port << "监听失败:" << transport_->errorString();
         return false;
     }
-    qInfo() << "服务器正在监听" << server_.serverAddress().toString() << ":" << port;
+    qCInfo(lcServer) << "服务器正在监听" << transport_->serverAddress().toString() << ":" << port
+                     << "，传输层" << transport_->name();
     return true;
 }
 
-// 处理新的客户端连接
-void RoomHub::onNewConnection()
+// 处理新的客户端连接（传输层每接受一个连接调用一次）
+void RoomHub::onNewConnection(Connection* sock)
 {
-    // 循环处理所有待处理的连接（可能有多个同时到来）
-    while (server_.hasPendingConnections())
-    {
-        // 获取下一个待处理的连接
-        QTcpSocket* sock = server_.nextPendingConnection();
+    // 从连接记录池取一条记录，关联客户端连接
+    createClient(sock);
 
-        // 创建客户端上下文对象，存储客户端相关信息
-        auto* ctx = new ClientCtx;
-        ctx->sock = sock;  // 关联客户端套接字
+    // 输出新客户端连接信息（IP地址和端口）
+    qCInfo(lcNet) << "新客户端连接来自" << sock->peerAddress().toString() << sock->peerPort();
+}
 
-        // 将客户端添加到客户端映射表中（套接字->上下文）
-        clients_.insert(sock, ctx);
+void RoomHub::admitAll(const QString& roomId, bool fragments)
+{
+    for (ClientCtx* c : clients_) {
+        c->isAuthenticated = true;
+        c->fragments = fragments;
+        c->buffer.setReassemble(fragments);
+        joinRoom(c, roomId);
+    }
+}
 
-        // 输出新客户端连接信息（IP地址和端口）
-        qInfo() << "新客户端连接来自" << sock->peerAddress().toString() << sock->peerPort();
+void RoomHub::dropAllClients()
+{
+    while (!clients_.isEmpty())
+        dropClient(clients_.last());
+}
 
-        // 当客户端有数据可读时，调用onReadyRead处理
-        connect(sock, &QTcpSocket::readyRead, this, &RoomHub::onReadyRead);
-        // 当客户端断开连接时，调用onDisconnected处理
-        connect(sock, &QTcpSocket::disconnected, this, &RoomHub::onDisconnected);
+// 多worker模式：描述符由 HubServer 在accept线程取得，连接在本worker线程创建（无父对象，便于迁移）
+void RoomHub::adoptDescriptor(qintptr socketDescriptor)
+{
+    Connection* sock = transport_->adoptDescriptor(socketDescriptor);
+    if (!sock)
+    {
+        qCWarning(lcNet) << "接管连接失败:" << transport_->errorString();
+        return;
     }
+    createClient(sock);
+    qCInfo(lcNet) << "新客户端连接来自" << sock->peerAddress().toString() << sock->peerPort()
+            << "，线程" << QThread::currentThread()->objectName();
 }
 
-// 处理客户端断开连接
-void RoomHub::onDisconnected()
+// 为新连接分配连接记录并挂载
+ClientCtx* RoomHub::createClient(Connection* sock)
 {
-    // 获取发送信号的套接字（即断开连接的客户端）
-    auto* sock = qobject_cast<QTcpSocket*>(sender());
-    if (!sock) return;  // 如果不是QTcpSocket类型，直接返回
+    ClientCtx* ctx = clientPool().create();
+    ctx->sock = sock;
+    // 分片帧本身也交付出来，用于直通转发；登录协商分片之前不重组（不为未认证的连接分配重组内存）
+    ctx->buffer.setDeliverFragments(true);
+    ctx->buffer.setReassemble(false);
+    attachSocket(sock, ctx);
+    return ctx;
+}
 
-    // 在客户端映射表中查找该客户端
-    auto it = clients_.find(sock);
-    if (it == clients_.end()) return;  // 未找到客户端，直接返回
+// 登记连接并挂载socket事件；lambda 捕获连接记录，信号到达时无需 sender() 与查表
+void RoomHub::attachSocket(Connection* sock, ClientCtx* ctx)
+{
+    ctx->clientSlot = clients_.size();
+    clients_.append(ctx);
+    // 计时器在本worker线程启动（RoomHub 可能在创建后才移到worker线程）
+    if (!egressReport_->isActive())
+        egressReport_->start();
 
-    ClientCtx* c = it.value();  // 获取客户端上下文
+    // 当客户端有数据可读时读取并处理
+    connect(sock, &Connection::readyRead, this, [this, ctx]() { readClient(ctx); });
+    // 当客户端断开连接时清理
+    connect(sock, &Connection::disconnected, this, [this, ctx]() { dropClient(ctx); });
+    // socket发送缓冲有空间时继续写出排队的消息
+    connect(sock, &Connection::bytesWritten, this, [ctx]() { ctx->egress.flush(ctx->sock); });
 
-    // 如果客户端属于某个房间，从房间中移除
-    if (!c->roomId.isEmpty()) {
-        // 查找该房间的所有客户端
-        auto range = rooms_.equal_range(c->roomId);
-        // 遍历房间中的客户端，移除当前断开连接的客户端
-        for (auto i = range.first; i != range.second; ) {
-            if (i.value() == sock) {
-                i = rooms_.erase(i);  // 从房间中删除
-            } else {
-                ++i;  // 继续下一个
-            }
-        }
+    // 限制内核发送缓冲：默认自动调优可达数MB，积在内核里的视频会让优先级调度失效
+    sock->setSendBufferSize(kKernelSendBuffer);
+}
+
+// 断开socket事件并从连接列表移除（与末尾交换，O(1)）
+void RoomHub::detachSocket(ClientCtx* c)
+{
+    disconnect(c->sock, nullptr, this, nullptr);
+    ClientCtx* last = clients_.last();
+    clients_[c->clientSlot] = last;
+    last->clientSlot = c->clientSlot;
+    clients_.removeLast();
+    c->clientSlot = -1;
+}
+
+// 定期报告：只输出上次报告以来有新增丢帧的连接（连接存续期间即可看到，不必等断开时的汇总）
+void RoomHub::reportEgress()
+{
+    if (clients_.isEmpty()) {
+        egressReport_->stop();
+        return;
+    }
+    for (ClientCtx* c : clients_) {
+        const quint64 total = c->egress.totalDropped();
+        if (total == c->reportedDrops) continue;
+        qCInfo(lcNet) << "Egress drops - User:" << c->user << "Room:" << roomIdOf(c)
+                      << "+" << (total - c->reportedDrops) << "total" << c->egress.dropSummary()
+                      << "queued" << c->egress.queuedItems() << "items" << c->egress.queuedBytes() << "bytes";
+        c->reportedDrops = total;
     }
+}
+
+// 移除并释放一个连接
+void RoomHub::dropClient(ClientCtx* c)
+{
+    Connection* sock = c->sock;
 
     // 输出客户端断开连接的信息
     if(!c->user.isEmpty())
     {
-        qInfo()<<"Client disconnected - User:"<<c->user<<"Room:"<<c->roomId;
+        qCInfo(lcNet)<<"Client disconnected - User:"<<c->user<<"Room:"<<roomIdOf(c);
     }
     else
     {
-        qInfo()<<"Client disconnected - Unauthenticated user from"<<sock->peerAddress().toString();
+        qCInfo(lcNet)<<"Client disconnected - Unauthenticated user from"<<sock->peerAddress().toString();
+    }
+    if(c->egress.totalDropped() > 0)
+    {
+        qCInfo(lcNet)<<"Client egress drops - User:"<<c->user<<c->egress.dropSummary();
     }
 
-    // 从客户端映射表中移除
-    clients_.erase(it);
+    // 会话进入宽限期（房间记录保留在会话中，重连后恢复）
+    if (c->sessionId)
+        SessionStore::instance().detach(c->sessionId, c->sessionEpoch);
 
-    buffers_.remove(sock);
+    // 如果客户端属于某个房间，从房间中移除
+    leaveRoom(c);
+    // 仍在等待数据库结果：结果回来时丢弃
+    if (c->dbTicket)
+        dbWaiting_.remove(c->dbTicket);
+
+    // 断开信号并从连接列表中移除（之后排队中的信号不会再引用本记录）
+    detachSocket(c);
 
     // 安排套接字在适当的时候删除
     sock->deleteLater();
-    // 删除客户端上下文对象
-    delete c;
+    // 连接记录放回池中
+    clientPool().destroy(c);
 }
 //End of Part 1
 
 //Part 2 clients' data processing
 // 处理客户端发送的数据
-void RoomHub::onReadyRead()
-{
-    // 获取发送数据的客户端套接字
-    auto* sock = qobject_cast<QTcpSocket*>(sender());
-    if (!sock) return;  // 无效的套接字，直接返回
-
-    // 查找客户端上下文
-    auto it = clients_.find(sock);
-    if (it == clients_.end()) return;  // 未找到客户端，直接返回
-
-    ClientCtx* c = it.value();  // 获取客户端上下文
-
-    //为每个套接字维护一个接收缓冲区
-    QByteArray& buf = buffers_[sock];  // 获取当前客户端的缓冲区
-    QByteArray newData = sock->readAll();  // 读取新收到的数据
-        if (!newData.isEmpty()) {  // 如果有新数据
-            // 打印：客户端IP、收到的字节数、前20字节（十六进制，方便核对）
-            qInfo() << "[TCP接收] 客户端" << sock->peerAddress().toString()
-                     << "收到" << newData.size() << "字节，前20字节：" << newData.left(20).toHex();
-            // 打印当前缓冲区总长度（判断是否数据不完整）
-            buf.append(newData);  // 将新数据追加到缓冲区
-            qInfo() << "[TCP接收] 当前缓冲区总长度：" << buf.size() << "字节";
-        }
+void RoomHub::readClient(ClientCtx* c)
+{
+    // 等待数据库结果期间不读取：数据留在socket缓冲里（TCP反压），由 resumeClient 继续
+    if (c->dbTicket) return;
+
+    Connection* sock = c->sock;
+
+    //每个连接记录自带接收缓冲区
+    PacketBuffer& buf = c->buffer;
+    QByteArray newData = sock->read();  // 读取新收到的数据
+    if (!newData.isEmpty()) {  // 如果有新数据
+        buf.append(newData);  // 将新数据追加到缓冲区（无残留时直接共享，不复制）
+        c->rxBytes += quint64(newData.size());
+    }
 
     // 解析缓冲区中的数据包
     QVector<Packet> pkts;
-    // 从缓冲区中提取完整的数据包
-    if (drainPackets(buf, pkts)) {
-        // 处理每个提取到的数据包
-        for (const Packet& p : pkts) {
-            handlePacket(c, p);
-        }
+    const bool produced = buf.drain(pkts);
+    c->rxPackets += quint64(pkts.size());
+
+    // 热路径：debug级别且限频（hub.net.debug=true 时每秒最多一条），release构建中整段编译掉
+#ifndef QT_NO_DEBUG_OUTPUT
+    static LogThrottle readLogThrottle(1000);
+    int suppressed = 0;
+    if (lcNet().isDebugEnabled() && readLogThrottle.allow(&suppressed)) {
+        qCDebug(lcNet) << "[TCP接收]" << c->user << "收到" << newData.size() << "字节，解析出"
+                       << pkts.size() << "个包，缓冲区剩余" << buf.size() << "字节（另有"
+                       << suppressed << "次读取未记录）";
     }
-    else {
-           // 新增日志：未解析出完整数据包时的提示
-           if (buf.size() > 0) {
-               qInfo() << "[TCP解析] 未解析出完整数据包，当前缓冲区长度：" << buf.size() << "字节";
-           }
+#endif
+
+    // 处理每个提取到的数据包
+    if (produced)
+        processPackets(c, pkts, 0);
+}
+
+// 依次处理 pkts[from..]；若某个包导致连接迁移到其他worker，剩余的包随连接一起交过去
+// 返回连接是否仍归本worker
+bool RoomHub::processPackets(ClientCtx* c, const QVector<Packet>& pkts, int from)
+{
+    for (int i = from; i < pkts.size(); ++i) {
+        handlePacket(c, pkts.at(i));
+        if (c->migrateTo) {
+            migrateClient(c, pkts.mid(i + 1));
+            return false;
+        }
+        if (c->dbTicket) {
+            // 等待数据库结果：剩余的包按序暂存，结果回来后继续
+            c->parked += pkts.mid(i + 1);
+            return true;
+        }
     }
+    return true;
 }
 
 // 处理解析后的数据包
@@ -166,13 +297,28 @@ void RoomHub::onReadyRead()
 // p: 要处理的数据包
 void RoomHub::handlePacket(ClientCtx* c, const Packet& p)
 {
+    // 分片帧：边收边转发；最后一个分片之后 PacketBuffer 另行交付重组好的完整包，走下面的常规流程
+    if (p.fragment)
+    {
+        if (c->isAuthenticated && c->fragments && c->room >= 0 && isRelayType(p.type)) {
+            // 中止帧：发送方主动放弃，或本端重组因出错/淘汰作废了该流（PacketBuffer 生成）
+            if (p.fragmentAbort()) {
+                if (c->relayStreams.contains(p.streamId))
+                    abortRelay(c->relayStreams.take(p.streamId));
+            } else {
+                relayFragment(c, p);
+            }
+        }
+        return;
+    }
+
     if(p.type == MSG_REGISTER)
     {
-        QString username = p.json.value("username").toString();
-        QString password = p.json.value("password").toString();
-        QString email = p.json.value("email").toString();
-        QString phone = p.json.value("phone").toString();
-        int userType = p.json.value("user_type").toInt();
+        QString username = p.username();
+        QString password = p.stringField("password");
+        QString email = p.stringField("email");
+        QString phone = p.stringField("phone");
+        int userType = p.userType();
 
         if(username.isEmpty()||password.isEmpty()||userType<=0)
         {
@@ -181,30 +327,19 @@ void RoomHub::handlePacket(ClientCtx* c, const Packet& p)
                 {"code",400},
                 {"message","Invalid parameters: username/password/user_type cannot be empty"}
             };
-            c->sock->write(buildPacket(MSG_SERVER_EVENT,resp));
+            sendEvent(c, resp);
             return;
         }
 
-        bool registerSuccess = dbManager_.addUser(username,password,email,phone,userType);
-        if(registerSuccess)
-        {
-            QJsonObject resp
-            {
-                {"code",0},
-                {"message","User registered successfully"},
-                {"username",username}
-            };
-            c->sock->write(buildPacket(MSG_SERVER_EVENT,resp));
-        }
-        else
-        {
-            QJsonObject resp
-            {
-                {"code",409},
-                {"message","Username already exists"}
-            };
-            c->sock->write(buildPacket(MSG_SERVER_EVENT,resp));
-        }
+        // 交给DB线程；完成前暂停处理该连接的后续消息，其他连接照常转发
+        const quint64 ticket = awaitDb(c);
+        DbWorker::instance().addUser(username,password,email,phone,userType,this,
+            [this, ticket, username](bool ok) {
+                ClientCtx* c = resumeDb(ticket);
+                if (!c) return; // 等待期间已断开
+                finishRegister(c, username, ok);
+                resumeClient(c);
+            });
         return;
     }
 
@@ -218,56 +353,35 @@ void RoomHub::handlePacket(ClientCtx* c, const Packet& p)
                 {"code",400},
                 {"message","Already logged in."}
             };
-            c->sock->write(buildPacket(MSG_SERVER_EVENT,response));
+            sendEvent(c, response);
             return;
         }
 
     //解析登录数据
-    QString username=p.json.value("username").toString();
-    QString password=p.json.value("password").toString();
-    int userType = p.json.value("user_type").toInt();
+    QString username=p.username();
+    QString password=p.stringField("password");
+    int userType = p.userType();
+    // 协商字段在完成回调中使用，先从消息体取出（消息体是接收块的视图）
+    const bool wantsCbor = p.json().value("encodings").toArray().contains(QJsonValue("cbor"));
+    const bool wantsFragments = p.json().value("fragments").toBool();
 
-    if(//username == "factory" && password =="123456"
-            dbManager_.validateUser(username,password,userType))
-    {
-        c->user =username;
-        c->isAuthenticated =true;
-        QJsonObject response
-        {
-            {"code", 0},
-            {"message", "Login successful."},
-            {"username", username} // 可以返回角色信息供客户端使用
-        };
-        c->sock->write(buildPacket(MSG_SERVER_EVENT,response));
-        qInfo()<<"User logged in:"<<username<<"from"<<c->sock->peerAddress();
-    }
-//    else if(username == "expert"&&password == "123456")
-//    {
-//        c->user =username;
-//        c->isAuthenticated = true;
-//        QJsonObject response
-//        {
-//            {"code", 0},
-//            {"message", "Login successful."},
-//            {"role", "expert"}
-//        };
-//        c->sock->write(buildPacket(MSG_SERVER_EVENT, response));
-//        qInfo() << "User logged in:" << username << "from" << c->sock->peerAddress();
-//    }
-    else
-    {
-        // 失败
-        QJsonObject response
-        {
-            {"code", 401},
-            {"message", "Invalid username or password."}
-        };
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, response));
-        qInfo() << "Login failed for user:" << username << "from" << c->sock->peerAddress();
-    }
+    const quint64 ticket = awaitDb(c);
+    DbWorker::instance().validateUser(username,password,userType,this,
+        [this, ticket, username, wantsCbor, wantsFragments](bool ok) {
+            ClientCtx* c = resumeDb(ticket);
+            if (!c) return; // 等待期间已断开
+            finishLogin(c, username, ok, wantsCbor, wantsFragments);
+            resumeClient(c);
+        });
     return;
     }
 
+    if(p.type == MSG_RESUME_SESSION)
+    {
+        handleResume(c, p);
+        return;
+    }
+
     //安全检查 - 后续所有请求都必须先登录
     if (!c->isAuthenticated)
     {
@@ -276,7 +390,7 @@ void RoomHub::handlePacket(ClientCtx* c, const Packet& p)
             {"code", 403},
             {"message", "Authentication required. Please login first."}
         };
-            c->sock->write(buildPacket(MSG_SERVER_EVENT, response));
+            sendEvent(c, response);
             return; // 未登录用户无法进行任何其他操作
     }
     // 处理其他已认证的请求
@@ -284,14 +398,14 @@ void RoomHub::handlePacket(ClientCtx* c, const Packet& p)
     if (p.type == MSG_JOIN_WORKORDER)
     {
         // 从数据包中解析房间ID和用户名
-        const QString roomId = p.json.value("roomId").toString();
+        const QString roomId = p.roomId();
 
         // 检查房间ID是否为空
         if (roomId.isEmpty()) {
             // 构造错误响应：缺少roomId
             QJsonObject j{{"code",400},{"message","需要roomId"}};
             // 发送响应给客户端
-            c->sock->write(buildPacket(MSG_SERVER_EVENT, j));
+            sendEvent(c, j);
             return;
         }
 
@@ -302,36 +416,329 @@ void RoomHub::handlePacket(ClientCtx* c, const Packet& p)
             user = "anonymous";
         }
 
-        // 加入指定房间
-        joinRoom(c, roomId);
+        // 加入指定房间；房间属于其他worker时连接会被迁移过去，由其回复加入结果
+        if (!joinRoom(c, roomId))
+            return;
 
-        // 构造成功响应
+        // 构造成功响应，随后发送房间快照
         QJsonObject j{{"code",0},{"message","已加入"},{"roomId",roomId}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, j));
+        sendEvent(c, j);
+        sendSnapshot(c, true);
         return;
     }
 
     // 检查客户端是否已加入房间，未加入则拒绝后续操作
-    if (c->roomId.isEmpty()) {
+    if (c->room < 0) {
         QJsonObject j{{"code",403},{"message","请先加入一个房间"}};
-        c->sock->write(buildPacket(MSG_SERVER_EVENT, j));
+        sendEvent(c, j);
+        return;
+    }
+
+    if (p.type == MSG_REPLAY_CONTROL) {
+        handleReplay(c, p);
+        return;
+    }
+
+    if (p.type == MSG_DEVICE_QUERY) {
+        handleDeviceQuery(c, p);
         return;
     }
 
     // 处理各种类型的消息，转发到同一房间的其他客户端
-    if (p.type == MSG_TEXT || p.type == MSG_DEVICE_DATA ||
-        p.type == MSG_VIDEO_FRAME || p.type == MSG_AUDIO_FRAME ||
-        p.type == MSG_CONTROL) {
-        // 构建原始数据包（保持原样，服务端不修改内容）
-        QByteArray raw = buildPacket(p.type, p.json, p.bin);
-        // 广播到房间内其他客户端（排除发送者自己）
-        broadcastToRoom(c->roomId, raw, c->sock);
+    if (isRelayType(p.type)) {
+        // 透传快速路径：直接转发接收到的原始帧字节，不解码、不重新打包、不复制负载
+        relayToRoom(c, p);
         return;
     }
 
     // 处理未识别的消息类型
     QJsonObject j{{"code",404},{"message",QString("未知消息类型 %1").arg(p.type)}};
-    c->sock->write(buildPacket(MSG_SERVER_EVENT, j));
+    sendEvent(c, j);
+}
+
+// 注册结果（DB线程完成后在本线程调用）
+void RoomHub::finishRegister(ClientCtx* c, const QString& username, bool registerSuccess)
+{
+        if(registerSuccess)
+        {
+            QJsonObject resp
+            {
+                {"code",0},
+                {"message","User registered successfully"},
+                {"username",username}
+            };
+            sendEvent(c, resp);
+        }
+        else
+        {
+            QJsonObject resp
+            {
+                {"code",409},
+                {"message","Username already exists"}
+            };
+            sendEvent(c, resp);
+        }
+}
+
+// 登录结果（DB线程完成后在本线程调用）
+void RoomHub::finishLogin(ClientCtx* c, const QString& username, bool ok,
+                          bool wantsCbor, bool wantsFragments)
+{
+    if(ok)
+    {
+        c->user =username;
+        c->isAuthenticated =true;
+        // 签发可恢复会话：断线后凭 token 以 MSG_RESUME_SESSION 恢复身份与房间
+        SessionStore& sessions = SessionStore::instance();
+        const QString token = sessions.create(username, this, &c->sessionId, &c->sessionEpoch);
+        QJsonObject response
+        {
+            {"code", 0},
+            {"message", "Login successful."},
+            {"username", username}, // 可以返回角色信息供客户端使用
+            {"sessionToken", token},
+            {"sessionGraceMs", sessions.gracePeriod()}
+        };
+        // 消息体编码协商：客户端声明支持CBOR时确认，本响应仍用JSON，之后的消息改用CBOR
+        if (wantsCbor)
+            response.insert("bodyEncoding", "cbor");
+        // 分片帧协商：确认后双方都可以发送分片帧
+        c->fragments = wantsFragments;
+        c->buffer.setReassemble(c->fragments);
+        if (c->fragments)
+            response.insert("fragments", true);
+        sendEvent(c, response);
+        if (wantsCbor)
+            c->encoding = BODY_CBOR;
+        qCInfo(lcAuth)<<"User logged in:"<<username<<"from"<<c->sock->peerAddress();
+    }
+    else
+    {
+        // 失败
+        QJsonObject response
+        {
+            {"code", 401},
+            {"message", "Invalid username or password."}
+        };
+        sendEvent(c, response);
+        qCInfo(lcAuth) << "Login failed for user:" << username << "from" << c->sock->peerAddress();
+    }
+}
+
+// 断线重连：校验 token，恢复身份，重新加入会话记录的房间，一个往返内完成
+// 会话仍附着在旧连接上（服务器尚未察觉断线）时接管：通知旧连接所在worker将其断开
+void RoomHub::handleResume(ClientCtx* c, const Packet& p)
+{
+    if (c->isAuthenticated)
+    {
+        QJsonObject response{{"code",400},{"message","Already logged in."}};
+        sendEvent(c, response);
+        return;
+    }
+
+    SessionStore::Resumed r;
+    if (!SessionStore::instance().resume(p.stringField("token"), this, &r))
+    {
+        QJsonObject response{{"code",401},{"message","Session expired, please login again."}};
+        sendEvent(c, response);
+        qCInfo(lcAuth) << "Session resume rejected from" << c->sock->peerAddress();
+        return;
+    }
+
+    c->user = r.user;
+    c->isAuthenticated = true;
+    c->sessionId = r.id;
+    c->sessionEpoch = r.epoch;
+    c->resuming = true;
+    c->resumeCbor = p.json().value("encodings").toArray().contains(QJsonValue("cbor"));
+    c->fragments = p.json().value("fragments").toBool();
+    c->buffer.setReassemble(c->fragments);
+    c->resumeChatSeq = r.chatSeq;
+    qCInfo(lcAuth) << "Session resumed:" << r.user << "from" << c->sock->peerAddress() << "room" << r.roomId;
+
+    if (r.previousOwner) {
+        RoomHub* owner = r.previousOwner;
+        const quint64 id = r.id;
+        const quint32 epoch = r.previousEpoch;
+        QMetaObject::invokeMethod(owner, [owner, id, epoch]() {
+            owner->dropSession(id, epoch);
+        }, Qt::QueuedConnection);
+    }
+
+    // 房间属于其他worker时连接先迁移过去，由其 adoptClient 完成恢复
+    if (!r.roomId.isEmpty() && !joinRoom(c, r.roomId))
+        return;
+    finishResume(c);
+}
+
+// 回复恢复结果，然后补发断线期间错过的聊天
+void RoomHub::finishResume(ClientCtx* c)
+{
+    c->resuming = false;
+
+    QList<Room::ChatEntry> missed;
+    if (c->room >= 0) {
+        for (const Room::ChatEntry& e : rooms_.at(c->room).chat) {
+            if (e.seq > c->resumeChatSeq)
+                missed.append(e);
+        }
+    }
+
+    QJsonObject response
+    {
+        {"code", 0},
+        {"message", "Session resumed."},
+        {"username", c->user},
+        {"roomId", roomIdOf(c)},
+        {"replayed", missed.size()}
+    };
+    if (c->resumeCbor)
+        response.insert("bodyEncoding", "cbor");
+    if (c->fragments)
+        response.insert("fragments", true);
+    sendEvent(c, response);
+    if (c->resumeCbor)
+        c->encoding = BODY_CBOR;
+
+    for (const Room::ChatEntry& e : missed)
+        sendFrame(c, MSG_TEXT, e.frame, e.frame, e.encoding, 0);
+    sendSnapshot(c, false);
+}
+
+// 会话已被新连接接管：断开仍附着该会话的旧连接（不再让会话进入宽限期）
+void RoomHub::dropSession(quint64 id, quint32 epoch)
+{
+    for (ClientCtx* c : clients_) {
+        if (c->sessionId == id && c->sessionEpoch == epoch) {
+            qCInfo(lcAuth) << "Session taken over by a new connection:" << c->user;
+            c->sessionId = 0;
+            dropClient(c);
+            return;
+        }
+    }
+}
+
+// 记录一条聊天消息（自有副本），供断线重连的成员补发
+void RoomHub::recordChat(ClientCtx* from, const Packet& p)
+{
+    SessionStore& sessions = SessionStore::instance();
+    Room& room = rooms_[from->room];
+    const QByteArray raw = p.frame();
+    Room::ChatEntry e;
+    e.seq = sessions.nextChatSeq();
+    e.ms = QDateTime::currentMSecsSinceEpoch();
+    e.frame = QByteArray(raw.constData(), raw.size());
+    e.encoding = p.encoding;
+    room.chat.append(e);
+    if (room.chat.size() > kChatHistory)
+        room.chat.removeFirst();
+}
+
+// 更新房间快照中发送方的最新视频帧：每次更新复制一份自有副本，
+// 只引用接收块会让快照长期占住整个块（块内其余帧早已处理完）
+void RoomHub::updateSnapshot(ClientCtx* from, const Packet& p)
+{
+    Room& room = rooms_[from->room];
+    if (p.frameSize > kSnapshotMaxFrame) {
+        room.lastVideo.remove(from);
+        return;
+    }
+    auto it = room.lastVideo.find(from);
+    if (it == room.lastVideo.end()) {
+        if (room.lastVideo.size() >= kSnapshotVideoSenders) return;
+        it = room.lastVideo.insert(from, Room::SnapshotFrame());
+    }
+    const QByteArray raw = p.frame();
+    it->frame = QByteArray(raw.constData(), raw.size());
+    it->encoding = p.encoding;
+}
+
+// 设备数据：数值写入时序库（按工单/设备/指标，时间取服务器收到的时间），
+// 并更新房间快照中该指标的最新值（很小，保存自有副本以免长期占用整个接收块）
+void RoomHub::recordDeviceData(ClientCtx* from, const Packet& p)
+{
+    Room& room = rooms_[from->room];
+    const QString deviceId = p.stringField("deviceId");
+    const QString metric = p.stringField("type");
+    bool numeric = false;
+    const double value = p.doubleField("value", &numeric);
+    if (numeric && !deviceId.isEmpty() && !metric.isEmpty())
+        TimeSeriesStore::instance().append(room.id, deviceId, metric,
+                                           QDateTime::currentMSecsSinceEpoch(), value);
+
+    const QString key = deviceId + '/' + metric;
+    auto it = room.lastDevice.find(key);
+    if (it == room.lastDevice.end()) {
+        if (room.lastDevice.size() >= kSnapshotDevices) return;
+        it = room.lastDevice.insert(key, Room::SnapshotFrame());
+    }
+    const QByteArray raw = p.frame();
+    it->frame = QByteArray(raw.constData(), raw.size());
+    it->encoding = p.encoding;
+}
+
+// 加入成功后紧接着发送房间快照：最近的聊天、各设备指标的最新值、各发送方的最新视频帧，
+// 新成员不必等下一帧视频或下一次设备上报。恢复会话时聊天已按序号补发，只发后两项
+void RoomHub::sendSnapshot(ClientCtx* c, bool withChat)
+{
+    if (c->room < 0) return;
+    const Room& room = rooms_.at(c->room);
+    if (withChat) {
+        for (int i = qMax(0, room.chat.size() - kSnapshotChat); i < room.chat.size(); ++i) {
+            const Room::ChatEntry& e = room.chat.at(i);
+            sendFrame(c, MSG_TEXT, e.frame, e.frame, e.encoding, 0);
+        }
+    }
+    for (const Room::SnapshotFrame& f : room.lastDevice)
+        sendFrame(c, MSG_DEVICE_DATA, f.frame, f.frame, f.encoding, 0);
+    for (auto it = room.lastVideo.constBegin(); it != room.lastVideo.constEnd(); ++it) {
+        if (it.key() == c) continue;
+        sendFrame(c, MSG_VIDEO_FRAME, it->frame, it->frame, it->encoding, quintptr(it.key()));
+    }
+}
+
+// 发送一个已保存的完整帧；接收方编码不同时只重编码消息体
+void RoomHub::sendFrame(ClientCtx* to, quint16 type, const QByteArray& frame, const QByteArray& keepAlive,
+                        BodyEncoding encoding, quintptr source)
+{
+    if (encoding == to->encoding) {
+        sendTo(to, type, &frame, 1, keepAlive, source);
+        return;
+    }
+    QByteArray copy = frame;
+    QVector<Packet> pkts;
+    if (!drainPackets(copy, pkts) || pkts.isEmpty()) return;
+    const Packet& p = pkts.first();
+    const FramedPacket f = framePacket(type, encodeBody(p.json(), to->encoding), p.bin, to->encoding);
+    const QByteArray segs[3] = { f.header, f.json, f.bin };
+    sendTo(to, type, segs, 3, keepAlive, source); // p.bin 是 frame 的视图，底层数据由 keepAlive 持有
+}
+
+// 登记一个等待中的数据库请求；完成前该连接暂停读取和处理（见 readClient/processPackets）
+quint64 RoomHub::awaitDb(ClientCtx* c)
+{
+    c->dbTicket = ++nextDbTicket_;
+    dbWaiting_.insert(c->dbTicket, c);
+    return c->dbTicket;
+}
+
+// 取回等待结果的连接；连接已断开（dropClient 已注销）时返回 nullptr
+ClientCtx* RoomHub::resumeDb(quint64 ticket)
+{
+    ClientCtx* c = dbWaiting_.take(ticket);
+    if (c) c->dbTicket = 0;
+    return c;
+}
+
+// 继续处理等待期间暂存的消息，再读取socket中积压的数据
+void RoomHub::resumeClient(ClientCtx* c)
+{
+    const QVector<Packet> parked = c->parked;
+    c->parked.clear();
+    if (!processPackets(c, parked, 0) || c->dbTicket)
+        return;
+    // 等待期间到达的数据或对端关闭：都要读一次才能发现（epoll 传输在读到EOF时才报告断开）
+    readClient(c);
 }
 //End of Part2
 
@@ -339,40 +746,459 @@ void RoomHub::handlePacket(ClientCtx* c, const Packet& p)
 // 让客户端加入指定房间
 // c: 客户端上下文
 // roomId: 要加入的房间ID
-void RoomHub::joinRoom(ClientCtx* c, const QString& roomId) {
-    qInfo() << "[joinRoom] 进入函数，原始c->roomId=" << c->roomId << "，目标roomId=" << roomId;
+// 返回 false 表示房间属于其他worker，已标记迁移（c->migrateTo），调用方不应再回复
+bool RoomHub::joinRoom(ClientCtx* c, const QString& roomId) {
+    if (directory_) {
+        RoomHub* owner = directory_->claim(roomId, this);
+        if (owner != this) {
+            c->migrateTo = owner;
+            c->migrateRoomId = roomId;
+            return false;
+        }
+    }
+
+    // 重复加入当前房间：保持不变（先离开会让房间变空并释放归属登记）
+    if (c->room >= 0 && rooms_.at(c->room).id == roomId)
+        return true;
+
     // 如果客户端已在其他房间，先从原房间移除
-    if (!c->roomId.isEmpty()) {
-        auto range = rooms_.equal_range(c->roomId);
-        for (auto i = range.first; i != range.second; ) {
-            if (i.value() == c->sock) {
-                i = rooms_.erase(i);  // 从原房间删除
-            } else {
-                ++i;
+    leaveRoom(c);
+
+    // 将客户端添加到新房间（成员数组末尾）
+    const int handle = internRoom(roomId);
+    Room& room = rooms_[handle];
+    c->room = handle;
+    c->roomSlot = room.members.size();
+    room.members.append(c);
+    if (c->sessionId)
+        SessionStore::instance().setRoom(c->sessionId, c->sessionEpoch, roomId, this);
+    qCDebug(lcRoom) << c->user << "加入房间" << roomId << "，房间当前客户端数：" << room.members.size();
+    return true;
+}
+
+// 取 roomId 对应的房间句柄，不存在时分配（优先复用空闲句柄）
+int RoomHub::internRoom(const QString& roomId)
+{
+    auto it = roomHandles_.constFind(roomId);
+    if (it != roomHandles_.constEnd())
+        return it.value();
+
+    int handle;
+    if (!freeRooms_.isEmpty()) {
+        handle = freeRooms_.takeLast();
+    } else {
+        handle = rooms_.size();
+        rooms_.append(Room());
+    }
+    rooms_[handle].id = roomId;
+    roomHandles_.insert(roomId, handle);
+    return handle;
+}
+
+QString RoomHub::roomIdOf(const ClientCtx* c) const
+{
+    return c->room >= 0 ? rooms_.at(c->room).id : QString();
+}
+
+// 离开当前房间：与末尾成员交换后删除；房间变空时回收句柄并释放其在归属表中的登记
+void RoomHub::leaveRoom(ClientCtx* c)
+{
+    if (c->room < 0) return;
+
+    Room& room = rooms_[c->room];
+    // 不再接收同房间发送方正在直通转发的分片流（已收到的部分由中止帧作废）
+    for (ClientCtx* m : room.members) {
+        for (auto it = m->relayStreams.begin(); it != m->relayStreams.end(); ++it) {
+            if (it->receivers.contains(c)) {
+                abortRelay(it.value(), c);
+                it->receivers.removeAll(c);
             }
         }
     }
+    // 自己正在发送的流不会再有后续分片
+    for (const ClientCtx::RelayStream& rs : c->relayStreams)
+        abortRelay(rs);
+    c->relayStreams.clear();
+    room.lastVideo.remove(c);
+
+    ClientCtx* last = room.members.last();
+    room.members[c->roomSlot] = last;
+    last->roomSlot = c->roomSlot;
+    room.members.removeLast();
+
+    if (room.members.isEmpty()) {
+        if (directory_)
+            directory_->release(room.id, this);
+        roomHandles_.remove(room.id);
+        stopReplay(room);
+        room.id.clear();
+        room.chat.clear();
+        room.lastDevice.clear();
+        freeRooms_.append(c->room);
+    }
+    c->room = -1;
+    c->roomSlot = -1;
+}
+
+// 把连接整体迁移到拥有目标房间的worker：
+// 断开本线程的信号连接，socket/上下文/接收缓冲/未处理的包一起交给目标线程
+void RoomHub::migrateClient(ClientCtx* c, const QVector<Packet>& pending)
+{
+    Connection* sock = c->sock;
+    RoomHub* target = c->migrateTo;
+
+    leaveRoom(c);
+    detachSocket(c);
+
+    qCDebug(lcRoom) << "[migrate] 用户" << c->user << "迁移到房间" << c->migrateRoomId << "所在的worker";
+    transport_->release(sock, target->thread());
+    QMetaObject::invokeMethod(target, [target, c, pending]() {
+        target->adoptClient(c, pending);
+    }, Qt::QueuedConnection);
+}
+
+// 在本worker接管迁移过来的连接（接收缓冲随连接记录一起过来）：完成加入、回复、处理迁移途中积压的包
+void RoomHub::adoptClient(ClientCtx* c, const QVector<Packet>& pending)
+{
+    Connection* sock = c->sock;
+    transport_->adopt(sock);
+    attachSocket(sock, c);
+
+    const QString roomId = c->migrateRoomId;
+    c->migrateTo = nullptr;
+    c->migrateRoomId.clear();
+
+    // 迁移途中断开：disconnected信号已丢失，直接清理
+    if (!sock->isConnected()) {
+        dropClient(c);
+        return;
+    }
 
-    // 更新客户端的房间ID
-    c->roomId = roomId;
-    qInfo() << "[joinRoom] 已设置c->roomId=" << c->roomId << "（赋值后检查）";
-    // 将客户端添加到新房间
-    rooms_.insert(roomId, c->sock);
-    qInfo() << "客户端已添加到新房间" << roomId << "，房间当前客户端数：" << rooms_.count(roomId);
+    // 途中房间归属可能又变了：继续迁移
+    if (!joinRoom(c, roomId)) {
+        migrateClient(c, pending);
+        return;
+    }
+    if (c->resuming) {
+        finishResume(c);
+    } else {
+        QJsonObject j{{"code",0},{"message","已加入"},{"roomId",roomId}};
+        sendEvent(c, j);
+        sendSnapshot(c, true);
+    }
+    c->egress.flush(sock);
+
+    // 迁移期间到达的数据不会再触发readyRead，这里主动读取
+    if (processPackets(c, pending, 0) && sock->bytesAvailable() > 0)
+        readClient(c);
 }
 
 // 向房间内其他客户端广播数据包
-// roomId: 房间ID
-// packet: 要广播的数据包
+// room: 房间句柄（见 internRoom）
+// packet: 要广播的完整帧（需持有自身数据：接收方拥塞时会被排队）
 // except: 不需要接收广播的客户端（通常是发送者自己）
-void RoomHub::broadcastToRoom(const QString& roomId, const QByteArray& packet, QTcpSocket* except) {
-    // 查找该房间的所有客户端
-    auto range = rooms_.equal_range(roomId);
-    // 遍历所有客户端并发送数据包
-    for (auto i = range.first; i != range.second; ++i) {
-        QTcpSocket* s = i.value();
-        if (s == except) continue;  // 跳过不需要接收的客户端
-        s->write(packet);  // 发送数据包
+void RoomHub::broadcastToRoom(int room, const QByteArray& packet, Connection* except) {
+    if (packet.size() < 6 || room < 0 || room >= rooms_.size()) return;
+    const quint16 type = qFromBigEndian<quint16>(packet.constData() + 4) & ~kTypeCborFlag;
+    // 遍历该房间的所有客户端并发送数据包（经接收方发送队列，拥塞时按类型策略排队/丢弃）
+    const QVector<ClientCtx*> members = rooms_.at(room).members;
+    for (ClientCtx* to : members) {
+        if (to->sock == except) continue;  // 跳过不需要接收的客户端
+        sendTo(to, type, &packet, 1, packet, 0);
+    }
+}
+
+// 经接收方的有界发送队列写出
+// keepAlive: segs 为视图时，持有其底层数据（通常是接收块），排队期间保持有效
+// source: 发送方标识，用于“每个发送方只保留最新视频帧”
+void RoomHub::sendTo(ClientCtx* to, quint16 type, const QByteArray* segs, int count,
+                     const QByteArray& keepAlive, quintptr source)
+{
+    to->egress.send(to->sock, type, segs, count, keepAlive, source);
+}
+
+// 向单个客户端发送服务器事件（按该连接协商的消息体编码）
+void RoomHub::sendEvent(ClientCtx* c, const QJsonObject& j)
+{
+    const FramedPacket f = framePacket(MSG_SERVER_EVENT, j, QByteArray(), c->encoding);
+    const QByteArray segs[3] = { f.header, f.json, f.bin };
+    sendTo(c, MSG_SERVER_EVENT, segs, 3, QByteArray(), 0);
+}
+
+// 转发一条客户端消息到同房间其他成员
+// - 接收方编码与原帧一致时直接写原始帧字节
+// - 不一致时（例如CBOR发送方、旧JSON接收方）只重编码消息体，每种编码最多转码一次，bin不复制
+// - 由分片重组的包：已经直通收到全部分片的接收方跳过，其余（旧客户端等）收到完整帧
+void RoomHub::relayToRoom(ClientCtx* from, const Packet& p)
+{
+    if (p.type == MSG_TEXT)
+        recordChat(from, p);
+    else if (p.type == MSG_VIDEO_FRAME)
+        updateSnapshot(from, p);
+    else if (p.type == MSG_DEVICE_DATA)
+        recordDeviceData(from, p);
+    if (record_)
+        record_->push(rooms_.at(from->room).id, p);
+
+    const QVector<ClientCtx*> cutThrough =
+        p.reassembled ? from->relayStreams.take(p.streamId).receivers : QVector<ClientCtx*>();
+    deliverToRoom(from->room, p, quintptr(from), from, cutThrough);
+}
+
+// 把一个完整包发给房间成员（except 与 skip 中的成员除外），接收方编码不同时转码消息体
+void RoomHub::deliverToRoom(int room, const Packet& p, quintptr source,
+                            const ClientCtx* except, const QVector<ClientCtx*>& skip)
+{
+    const QByteArray raw = p.frame();
+    FramedPacket transcoded;
+    bool haveTranscoded = false;
+
+    const QVector<ClientCtx*> members = rooms_.at(room).members;
+    for (ClientCtx* to : members) {
+        if (to == except || skip.contains(to)) continue;
+        if (to->encoding == p.encoding) {
+            sendTo(to, p.type, &raw, 1, p.block, source);
+            continue;
+        }
+        if (!haveTranscoded) {
+            transcoded = framePacket(p.type, encodeBody(p.json(), to->encoding), p.bin, to->encoding);
+            haveTranscoded = true;
+        }
+        const QByteArray segs[3] = { transcoded.header, transcoded.json, transcoded.bin };
+        sendTo(to, p.type, segs, 3, p.block, source);
     }
 }
 
+// 回放控制：在当前房间开始/暂停/继续/定位/变速/停止回放一个录制的工单
+void RoomHub::handleReplay(ClientCtx* c, const Packet& p)
+{
+    const QJsonObject& j = p.json();
+    const QString action = j.value("action").toString();
+    Room& room = rooms_[c->room];
+
+    if (action == "start") {
+        if (!recorder_) {
+            sendEvent(c, QJsonObject{{"code",503},{"message","服务器未开启录制（--record-dir）"}});
+            return;
+        }
+        // 只能回放当前房间（工单）自己的录制：工单号来自客户端，不允许借此读取其他工单
+        const QString ticket = j.value("ticket").toString(room.id);
+        if (ticket != room.id) {
+            sendEvent(c, QJsonObject{{"code",403},{"message","只能回放当前工单的录制"},{"ticket",ticket}});
+            return;
+        }
+        auto* source = new ReplaySource(this);
+        if (!source->open(recorder_->pathFor(ticket))) {
+            delete source;
+            sendEvent(c, QJsonObject{{"code",404},{"message","没有该工单的录制"},{"ticket",ticket}});
+            return;
+        }
+        stopReplay(room);
+        const int handle = c->room;
+        connect(source, &ReplaySource::packet, this, [this, handle, source](quint16, const QByteArray& frame) {
+            replayPacket(handle, source, frame);
+        });
+        connect(source, &ReplaySource::finished, this, [this, handle, source]() {
+            Room& r = rooms_[handle];
+            if (r.replay != source) return;
+            qCInfo(lcRoom) << "Replay finished:" << r.replayTicket << "in room" << r.id;
+            stopReplay(r);
+        });
+        room.replay = source;
+        room.replayTicket = ticket;
+        source->setSpeed(j.value("speed").toDouble(1.0));
+        source->seek(qint64(j.value("offsetMs").toDouble(0)));
+        source->start();
+        qCInfo(lcRoom) << "Replay" << ticket << "into room" << room.id << "by" << c->user
+                       << "speed" << source->speed();
+    } else if (!room.replay) {
+        sendEvent(c, QJsonObject{{"code",404},{"message","当前房间没有进行中的回放"}});
+        return;
+    } else if (action == "pause") {
+        room.replay->pause();
+    } else if (action == "resume") {
+        room.replay->start();
+    } else if (action == "seek") {
+        room.replay->seek(qint64(j.value("offsetMs").toDouble(0)));
+    } else if (action == "speed") {
+        room.replay->setSpeed(j.value("speed").toDouble(1.0));
+    } else if (action == "stop") {
+        stopReplay(room);
+        sendEvent(c, QJsonObject{{"code",0},{"message","回放已停止"}});
+        return;
+    } else {
+        sendEvent(c, QJsonObject{{"code",400},{"message",QString("未知回放操作 %1").arg(action)}});
+        return;
+    }
+
+    const QJsonObject state{
+        {"ticket", room.replayTicket},
+        {"playing", room.replay->isPlaying()},
+        {"speed", room.replay->speed()},
+        {"positionMs", double(room.replay->positionMs())},
+        {"durationMs", double(room.replay->durationMs())}
+    };
+    sendEvent(c, QJsonObject{{"code",0},{"message","回放"},{"replay",state}});
+}
+
+static void putF32(uchar*& w, double v)
+{
+    const float f = float(v);
+    quint32 bits;
+    std::memcpy(&bits, &f, sizeof bits);
+    qToBigEndian<quint32>(bits, w);
+    w += 4;
+}
+
+// 请求中的毫秒时间戳：缺省时取 fallback；须为 [0, kDeviceQueryMaxMs] 内的有限数值
+// （NaN 或超出 qint64 的 double 直接转换是未定义行为）
+static bool timestampField(const QJsonObject& j, const QString& key, qint64 fallback, qint64* out)
+{
+    if (!j.contains(key)) {
+        *out = fallback;
+        return true;
+    }
+    const QJsonValue v = j.value(key);
+    const double ms = v.toDouble();
+    if (!v.isDouble() || !qIsFinite(ms) || ms < 0 || ms > double(kDeviceQueryMaxMs)) return false;
+    *out = qint64(ms);
+    return true;
+}
+
+// 设备历史查询：只能查询当前房间（工单）的数据
+// 在本线程内直接计算：优先用汇总，解压的原始点数有上限（TimeSeriesStore::kMaxRawDecode），且解压在分片锁外进行
+// 结果为降采样后的定长二进制记录（见 protocol.h MSG_DEVICE_SERIES），图表可直接绘制
+void RoomHub::handleDeviceQuery(ClientCtx* c, const Packet& p)
+{
+    const QJsonObject& j = p.json();
+    const QString deviceId = j.value("deviceId").toString();
+    const QString metric = j.value("type").toString();
+    if (deviceId.isEmpty() || metric.isEmpty()) {
+        sendEvent(c, QJsonObject{{"code",400},{"message","设备查询缺少 deviceId 或 type"},{"reqId",j.value("reqId")}});
+        return;
+    }
+    qint64 toMs = 0, fromMs = 0;
+    if (!timestampField(j, "toMs", QDateTime::currentMSecsSinceEpoch(), &toMs)
+        || !timestampField(j, "fromMs", qMax<qint64>(0, toMs - kDeviceQueryDefaultMs), &fromMs)) {
+        sendEvent(c, QJsonObject{{"code",400},{"message","fromMs/toMs 不是有效的时间戳"},{"reqId",j.value("reqId")}});
+        return;
+    }
+    if (fromMs > toMs) {
+        sendEvent(c, QJsonObject{{"code",400},{"message","fromMs 晚于 toMs"},{"reqId",j.value("reqId")}});
+        return;
+    }
+    const int points = j.value("points").toInt(kDeviceQueryDefaultPoints);
+
+    const QString& ticket = rooms_.at(c->room).id;
+    const TsQueryResult r = TimeSeriesStore::instance().query(ticket, deviceId, metric, fromMs, toMs, points);
+
+    // 偏移用 u32：跨度超过约49天时改以秒为单位
+    const qint64 unit = (toMs - fromMs) > qint64(0xFFFFFFFFu) ? 1000 : 1;
+    const bool buckets = !r.buckets.isEmpty();
+    const int count = buckets ? r.buckets.size() : r.points.size();
+    QByteArray bin(count * (buckets ? 16 : 8), Qt::Uninitialized);
+    uchar* w = reinterpret_cast<uchar*>(bin.data());
+    if (buckets) {
+        for (const TsBucket& b : r.buckets) {
+            qToBigEndian<quint32>(quint32(qMax<qint64>(0, b.startMs - fromMs) / unit), w);
+            w += 4;
+            putF32(w, b.min);
+            putF32(w, b.max);
+            putF32(w, b.avg());
+        }
+    } else {
+        for (const TsPoint& pt : r.points) {
+            qToBigEndian<quint32>(quint32((pt.ms - fromMs) / unit), w);
+            w += 4;
+            putF32(w, pt.value);
+        }
+    }
+
+    const QJsonObject reply{
+        {"reqId", j.value("reqId")},
+        {"deviceId", deviceId},
+        {"type", metric},
+        {"fromMs", double(fromMs)},
+        {"toMs", double(toMs)},
+        {"source", r.source},
+        {"layout", buckets ? "buckets" : "points"},
+        {"count", count},
+        {"timeUnitMs", double(unit)},
+        {"scanned", double(r.scanned)}
+    };
+    const FramedPacket f = framePacket(MSG_DEVICE_SERIES, reply, bin, c->encoding);
+    const QByteArray segs[3] = { f.header, f.json, f.bin };
+    sendTo(c, MSG_DEVICE_SERIES, segs, 3, QByteArray(), 0);
+}
+
+// 把回放的一帧注入房间：复制一次（映射视图只在本次调用期间有效），所有成员共享这份副本
+void RoomHub::replayPacket(int room, ReplaySource* source, const QByteArray& frame)
+{
+    if (rooms_.at(room).replay != source) return;
+    PacketBuffer parser;
+    parser.append(QByteArray(frame.constData(), frame.size()));
+    QVector<Packet> pkts;
+    if (!parser.drain(pkts)) return;
+    for (const Packet& p : pkts)
+        deliverToRoom(room, p, quintptr(source), nullptr, QVector<ClientCtx*>());
+}
+
+void RoomHub::stopReplay(Room& room)
+{
+    if (!room.replay) return;
+    room.replay->pause();
+    room.replay->deleteLater(); // 可能正处于其信号的发射过程中
+    room.replay = nullptr;
+    room.replayTicket.clear();
+}
+
+// 直通转发一个分片帧（cut-through）：不等整帧到齐，收到一片转发一片
+// - 流的第一个分片决定接收方：已协商分片、编码一致、且该类型没有积压的成员
+//   （有积压的接收方此时直通只会加剧拥塞，改为在重组后按丢帧策略收完整帧）
+// - 分片之间可以穿插其他消息，接收方发送队列按优先级调度，分片不参与丢弃
+// - 只改写头部中的 stream id，消息体与分片数据仍是接收块的视图
+void RoomHub::relayFragment(ClientCtx* from, const Packet& p)
+{
+    if (p.fragmentOffset == 0) {
+        if (from->relayStreams.contains(p.streamId))
+            abortRelay(from->relayStreams.take(p.streamId));
+        if (from->relayStreams.size() >= kMaxRelayStreams) {
+            // 只淘汰最早开始的流，其接收方收到中止帧
+            auto oldest = from->relayStreams.begin();
+            for (auto j = from->relayStreams.begin(); j != from->relayStreams.end(); ++j)
+                if (j->relayId < oldest->relayId) oldest = j;
+            abortRelay(oldest.value());
+            from->relayStreams.erase(oldest);
+        }
+        ClientCtx::RelayStream rs;
+        rs.relayId = quint32(s_relayStreamIds.fetchAndAddRelaxed(1)) + 1;
+        rs.type = p.type;
+        for (ClientCtx* to : rooms_.at(from->room).members) {
+            if (to == from) continue;
+            if (to->fragments && to->encoding == p.encoding && !to->egress.hasBacklog(p.type))
+                rs.receivers.append(to);
+        }
+        from->relayStreams.insert(p.streamId, rs);
+    }
+
+    auto it = from->relayStreams.constFind(p.streamId);
+    if (it == from->relayStreams.constEnd() || it->receivers.isEmpty()) return;
+
+    const QByteArray raw = p.frame();
+    const QByteArray segs[2] = {
+        rewriteFragmentHeader(p, it->relayId),
+        QByteArray::fromRawData(raw.constData() + kFragmentHeaderSize, raw.size() - kFragmentHeaderSize)
+    };
+    for (ClientCtx* to : it->receivers)
+        to->egress.sendFragment(to->sock, p.type, segs, 2, p.block);
+}
+
+// 放弃一个直通转发的流：已收到前面分片的接收方（only 非空时只发给它）收到中止帧，释放其重组状态
+void RoomHub::abortRelay(const ClientCtx::RelayStream& rs, const ClientCtx* only)
+{
+    const FramedPacket f = abortFragment(rs.type, rs.relayId);
+    for (ClientCtx* to : rs.receivers) {
+        if ((only && to != only) || !to->sock->isConnected()) continue;
+        to->egress.sendFragment(to->sock, rs.type, &f.header, 1, QByteArray());
+    }
+}
@@ -8,46 +8,186 @@
 #include <QtNetwork>
 #include <QDebug>
 #include "../../common/protocol.h"
-#include "databasemanager.h"
+#include "roomdirectory.h"
+#include "egressqueue.h"
+#include "transport.h"
+#include "slabpool.h"
 
+class RoomHub;
+struct ClientCtx;
+class Recorder;
+class RecordQueue;
+class ReplaySource;
+
+// 房间：roomId 在加入时驻留为整数句柄（RoomHub::rooms_ 的下标），之后的转发/离开只用句柄
+// 成员为紧凑数组，离开时与末尾成员交换后删除，O(1)
+struct Room
+{
+    QString id;
+    QVector<ClientCtx*> members;
+
+    // 最近的聊天消息（条数有限）：供断线重连的成员补发（见 SessionStore），最后几条也用于新成员的快照
+    struct ChatEntry {
+        quint64 seq = 0;               // 全局聊天序号
+        qint64 ms = 0;                 // 收到时间
+        QByteArray frame;              // 原始帧的自有副本（不占用接收块）
+        BodyEncoding encoding = BODY_JSON;
+    };
+    QList<ChatEntry> chat;
+
+    // 新成员加入时发送的快照（见 RoomHub::sendSnapshot）：每个发送方最新的视频帧、每个设备指标最新的值
+    // 帧与所有新成员共享（隐式共享，不按成员复制）；发送方数与设备指标数有上限
+    struct SnapshotFrame {
+        QByteArray frame;              // 完整帧（自有副本，不引用接收块）
+        BodyEncoding encoding = BODY_JSON;
+    };
+    QHash<ClientCtx*, SnapshotFrame> lastVideo;   // 发送方 -> 最新视频帧（发送方离开时删除）
+    QHash<QString, SnapshotFrame> lastDevice;     // "deviceId/type" -> 最新设备数据
+
+    // 正在向本房间回放的录制（MSG_REPLAY_CONTROL），房间变空时停止
+    ReplaySource* replay = nullptr;
+    QString replayTicket;
+};
+
+// 每个连接一条记录：socket、会话状态、接收缓冲、发送队列与统计都在这里
+// 从 SlabPool 分配；socket 的信号经捕获了记录指针的 lambda 进入 RoomHub，热路径不查表
 struct ClientCtx
 {
-    QTcpSocket* sock = nullptr;
+    Connection* sock = nullptr;
+    int clientSlot = -1;               // 在 RoomHub::clients_ 中的下标
+    PacketBuffer buffer;               // 接收缓冲区（读游标，避免逐包搬移）
+    quint64 rxBytes = 0;               // 收到的字节数
+    quint64 rxPackets = 0;             // 解析出的包数
     QString user;
-    QString roomId;
+    int room = -1;                     // 所在房间句柄，-1 表示未加入
+    int roomSlot = -1;                 // 在 Room::members 中的下标
     bool isAuthenticated = false; //登录认证状态标志
+    BodyEncoding encoding = BODY_JSON; // 登录时协商的消息体编码
+    EgressQueue egress;                // 发给该客户端的有界发送队列（含丢帧计数）
+    quint64 reportedDrops = 0;         // 上次定期报告时的丢帧总数（见 RoomHub::reportEgress）
+    bool fragments = false;            // 登录时协商：可接收分片帧（大帧直通转发）
+
+    // 该客户端作为发送方、正在直通转发的分片流：发送方 stream id -> 转发用 stream id 与接收方
+    // 接收方离开房间时由 leaveRoom 从同房间发送方的流中移除；流中途放弃时向接收方发中止帧（见 RoomHub::abortRelay）
+    struct RelayStream {
+        quint32 relayId = 0;           // 全局递增，也表示开始的先后
+        quint16 type = 0;
+        QVector<ClientCtx*> receivers;
+    };
+    QHash<quint32, RelayStream> relayStreams;
+
+    // 登录/注册交给DB线程期间的等待凭据（0 表示未等待）与暂存的后续消息
+    quint64 dbTicket = 0;
+    QVector<Packet> parked;
+
+    // 可恢复会话（见 SessionStore）：登录或恢复后 sessionId 非 0
+    quint64 sessionId = 0;
+    quint32 sessionEpoch = 0;
+    // 恢复进行中（加入房间时可能先迁移到其他worker）：编码协商结果与聊天补发起点
+    bool resuming = false;
+    bool resumeCbor = false;
+    quint64 resumeChatSeq = 0;
+
+    // 多worker模式：加入的房间属于其他worker时，记录迁移目标，由 processPackets 完成迁移
+    RoomHub* migrateTo = nullptr;
+    QString migrateRoomId;
 };
 
 class RoomHub : public QObject
 {
     Q_OBJECT
 public:
-    explicit RoomHub(QObject* parent=nullptr);
+    // transport: "qt"（默认）或 "epoll"，见 transport.h
+    explicit RoomHub(const QString& transport = QStringLiteral("qt"), QObject* parent=nullptr);
     bool start(quint16 port);
     bool startListening(const QHostAddress &address, quint16 port);
     QString lastError() const;
     QHostAddress serverAddress() const;
     ~RoomHub() override;
 
+    // 多worker模式（见 HubServer）：设置共享的房间归属表
+    void setDirectory(RoomDirectory* directory) { directory_ = directory; }
+    // 会话录制：转发的消息按工单（roomId）入队交给录制线程；在 start 之前、于创建线程调用
+    void setRecorder(Recorder* recorder);
+    // 在本线程中用accept得到的描述符创建socket并接管连接
+    void adoptDescriptor(qintptr socketDescriptor);
+
+    // 当前非空房间数
+    int roomCount() const { return roomHandles_.size(); }
+
+    // 基准测试（bench/）用：跳过登录/加入流程直接驱动房间转发
+    void adoptConnection(Connection* sock) { onNewConnection(sock); }
+    int clientCount() const { return clients_.size(); }
+    // 全部连接视为已认证并加入 roomId；fragments：视为已协商分片帧
+    void admitAll(const QString& roomId, bool fragments = false);
+    int roomHandle(const QString& roomId) const { return roomHandles_.value(roomId, -1); }
+    void broadcastToRoom(int room,
+                         const QByteArray& packet,
+                         Connection* except = nullptr);
+    void dropAllClients();
+
+    QString transportName() const { return transport_->name(); }
+
 private slots:
-    void onNewConnection();
-    void onReadyRead();
-    void onDisconnected();
+    void onNewConnection(Connection* conn);
 
 private:
-    QTcpServer server_;
-    // 连接索引：socket -> ClientCtx
-    QHash<QTcpSocket*, ClientCtx*> clients_;
-    // 房间索引：roomId -> sockets（允许多人）
-    QMultiHash<QString, QTcpSocket*> rooms_;
+    Transport* transport_;
+    // 本worker的全部连接（紧凑数组，断开时与末尾交换删除）；只用于遍历，热路径不查找
+    QVector<ClientCtx*> clients_;
+    // 房间表：句柄 -> Room；变空的房间句柄回收到 freeRooms_ 复用
+    QVector<Room> rooms_;
+    QVector<int> freeRooms_;
+    // 驻留表：roomId -> 句柄，只在加入/房间变空时访问
+    QHash<QString, int> roomHandles_;
 
-    QHash<QTcpSocket*,QByteArray>buffers_;
-
-    DatabaseManager& dbManager_;
+    // 等待数据库结果的连接：凭据 -> 连接（只在请求/完成/断开时访问）
+    QHash<quint64, ClientCtx*> dbWaiting_;
+    quint64 nextDbTicket_ = 0;
+    RoomDirectory* directory_ = nullptr; // 为空表示单线程模式
+    Recorder* recorder_ = nullptr;
+    RecordQueue* record_ = nullptr;      // 本worker的录制队列，为空表示不录制
+    QTimer* egressReport_ = nullptr;     // 定期报告各连接新增的丢帧（有连接时运行）
 
+    ClientCtx* createClient(Connection* sock);
+    void attachSocket(Connection* sock, ClientCtx* ctx);
+    void detachSocket(ClientCtx* c);
+    void readClient(ClientCtx* c);
+    void reportEgress();
+    bool processPackets(ClientCtx* c, const QVector<Packet>& pkts, int from);
+    void dropClient(ClientCtx* c);
     void handlePacket(ClientCtx* c, const Packet& p);
-    void joinRoom(ClientCtx* c, const QString& roomId);
-    void broadcastToRoom(const QString& roomId,
-                         const QByteArray& packet,
-                         QTcpSocket* except = nullptr);
+    void finishRegister(ClientCtx* c, const QString& username, bool registerSuccess);
+    void finishLogin(ClientCtx* c, const QString& username, bool ok,
+                     bool wantsCbor, bool wantsFragments);
+    void handleResume(ClientCtx* c, const Packet& p);
+    void finishResume(ClientCtx* c);
+    void dropSession(quint64 id, quint32 epoch);
+    void recordChat(ClientCtx* from, const Packet& p);
+    void updateSnapshot(ClientCtx* from, const Packet& p);
+    void recordDeviceData(ClientCtx* from, const Packet& p);
+    void sendSnapshot(ClientCtx* c, bool withChat);
+    void sendFrame(ClientCtx* to, quint16 type, const QByteArray& frame, const QByteArray& keepAlive,
+                   BodyEncoding encoding, quintptr source);
+    quint64 awaitDb(ClientCtx* c);
+    ClientCtx* resumeDb(quint64 ticket);
+    void resumeClient(ClientCtx* c);
+    bool joinRoom(ClientCtx* c, const QString& roomId);
+    void leaveRoom(ClientCtx* c);
+    int internRoom(const QString& roomId);
+    QString roomIdOf(const ClientCtx* c) const;
+    void migrateClient(ClientCtx* c, const QVector<Packet>& pending);
+    void adoptClient(ClientCtx* c, const QVector<Packet>& pending);
+    void relayToRoom(ClientCtx* from, const Packet& p);
+    void deliverToRoom(int room, const Packet& p, quintptr source,
+                       const ClientCtx* except, const QVector<ClientCtx*>& skip);
+    void handleReplay(ClientCtx* c, const Packet& p);
+    void handleDeviceQuery(ClientCtx* c, const Packet& p);
+    void replayPacket(int room, ReplaySource* source, const QByteArray& frame);
+    void stopReplay(Room& room);
+    void relayFragment(ClientCtx* from, const Packet& p);
+    void abortRelay(const ClientCtx::RelayStream& rs, const ClientCtx* only = nullptr);
+    void sendEvent(ClientCtx* c, const QJsonObject& j);
+    void sendTo(ClientCtx* to, quint16 type, const QByteArray* segs, int count,
+                const QByteArray& keepAlive, quintptr source);
 };
@@ -0,0 +1,122 @@
+#include "sessionstore.h"
+
+SessionStore& SessionStore::instance()
+{
+    static SessionStore store;
+    return store;
+}
+
+SessionStore::SessionStore()
+{
+    secret_.resize(32);
+    QRandomGenerator::system()->fillRange(reinterpret_cast<quint32*>(secret_.data()), secret_.size() / 4);
+}
+
+QByteArray SessionStore::sign(quint64 id) const
+{
+    return QMessageAuthenticationCode::hash(QByteArray::number(id, 16), secret_, QCryptographicHash::Sha256)
+            .toHex();
+}
+
+QString SessionStore::create(const QString& user, RoomHub* owner, quint64* id, quint32* epoch)
+{
+    // 会话id随机生成：签名防伪造，随机防止根据自己的 token 推测他人的id
+    quint64 sid = 0;
+    QMutexLocker lock(&mutex_);
+    expire(QDateTime::currentMSecsSinceEpoch());
+    do {
+        sid = QRandomGenerator::system()->generate64();
+    } while (sid == 0 || sessions_.contains(sid));
+
+    Session s;
+    s.user = user;
+    s.epoch = 1;
+    s.owner = owner;
+    sessions_.insert(sid, s);
+    *id = sid;
+    *epoch = s.epoch;
+    return QString::fromLatin1(QByteArray::number(sid, 16) + '.' + sign(sid));
+}
+
+bool SessionStore::resume(const QString& token, RoomHub* owner, Resumed* out)
+{
+    const int dot = token.indexOf('.');
+    if (dot <= 0) return false;
+    bool ok = false;
+    const quint64 sid = token.left(dot).toULongLong(&ok, 16);
+    if (!ok || sid == 0) return false;
+    // 长度固定的十六进制签名，逐字节比较全部字符，不因前缀匹配提前返回
+    const QByteArray expected = sign(sid);
+    const QByteArray given = token.mid(dot + 1).toLatin1();
+    if (given.size() != expected.size()) return false;
+    char diff = 0;
+    for (int i = 0; i < given.size(); ++i)
+        diff |= given.at(i) ^ expected.at(i);
+    if (diff != 0) return false;
+
+    QMutexLocker lock(&mutex_);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    expire(now);
+    auto it = sessions_.find(sid);
+    if (it == sessions_.end()) return false;
+    if (it->detachedMs != 0 && now - it->detachedMs > graceMs_) {
+        sessions_.erase(it);
+        return false;
+    }
+
+    Session& s = it.value();
+    out->id = sid;
+    out->user = s.user;
+    out->roomId = s.roomId;
+    if (s.detachedMs == 0) {
+        // 旧连接仍附着（半开连接）：由新连接接管，从此刻开始补发
+        out->previousOwner = s.owner;
+        out->previousEpoch = s.epoch;
+        out->chatSeq = chatSeq_.load();
+    } else {
+        out->chatSeq = s.chatSeq;
+    }
+    s.epoch++;
+    s.detachedMs = 0;
+    s.owner = owner;
+    out->epoch = s.epoch;
+    return true;
+}
+
+void SessionStore::setRoom(quint64 id, quint32 epoch, const QString& roomId, RoomHub* owner)
+{
+    QMutexLocker lock(&mutex_);
+    auto it = sessions_.find(id);
+    if (it == sessions_.end() || it->epoch != epoch) return;
+    it->roomId = roomId;
+    it->owner = owner;
+}
+
+void SessionStore::detach(quint64 id, quint32 epoch)
+{
+    QMutexLocker lock(&mutex_);
+    auto it = sessions_.find(id);
+    if (it == sessions_.end() || it->epoch != epoch) return;
+    it->detachedMs = QDateTime::currentMSecsSinceEpoch();
+    it->chatSeq = chatSeq_.load();
+    it->owner = nullptr;
+}
+
+int SessionStore::size() const
+{
+    QMutexLocker lock(&mutex_);
+    return sessions_.size();
+}
+
+// 清理超过宽限期的会话（调用方持锁；最多每秒扫描一次）
+void SessionStore::expire(qint64 nowMs)
+{
+    if (nowMs < nextExpireMs_) return;
+    nextExpireMs_ = nowMs + 1000;
+    for (auto it = sessions_.begin(); it != sessions_.end(); ) {
+        if (it->detachedMs != 0 && nowMs - it->detachedMs > graceMs_)
+            it = sessions_.erase(it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+// ===============================================
+// server/src/sessionstore.h
+// 可恢复会话：登录成功时签发 token，连接断开后会话记录保留一个宽限期
+// - token = 会话id + HMAC-SHA256 签名（进程启动时随机生成密钥，重启后旧 token 全部失效）
+// - 记录身份、所在房间，以及断开时的全局聊天序号，恢复时补发之后的聊天消息
+// - 进程级共享并加锁：客户端重连后可能落在另一个 worker 上
+// ===============================================
+#include <QtCore>
+
+class RoomHub;
+
+class SessionStore
+{
+public:
+    static SessionStore& instance();
+
+    // 断开后保留会话的时长
+    void setGracePeriod(int ms) { graceMs_ = ms; }
+    int gracePeriod() const { return graceMs_; }
+
+    // 登录成功时创建会话（已附着在 owner 上的当前连接），返回 token
+    QString create(const QString& user, RoomHub* owner, quint64* id, quint32* epoch);
+
+    struct Resumed {
+        QString user;
+        QString roomId;
+        quint64 chatSeq = 0;        // 从此序号之后的聊天需要补发
+        quint32 epoch = 0;          // 本次附着的版本号
+        RoomHub* previousOwner = nullptr; // 会话仍附着在旧连接上（服务器尚未察觉断线）时为其所在 worker
+        quint32 previousEpoch = 0;
+        quint64 id = 0;
+    };
+    // 校验 token 并把会话附着到 owner 上的新连接（之后再次接管时由 owner 断开该连接）；
+    // 签名错误、不存在或已过宽限期时返回 false
+    bool resume(const QString& token, RoomHub* owner, Resumed* out);
+
+    // 附着的连接加入房间后登记（epoch 不匹配说明会话已被新连接接管，忽略）；连接可能已迁移到 owner
+    void setRoom(quint64 id, quint32 epoch, const QString& roomId, RoomHub* owner);
+    // 连接断开：开始计算宽限期，记录断开时的聊天序号
+    void detach(quint64 id, quint32 epoch);
+
+    // 全局聊天序号（所有房间共用，单调递增）
+    quint64 nextChatSeq() { return chatSeq_.fetchAndAddRelaxed(1) + 1; }
+    quint64 chatSeq() const { return chatSeq_.load(); }
+
+    int size() const;
+
+private:
+    SessionStore();
+    struct Session {
+        QString user;
+        QString roomId;
+        quint32 epoch = 0;
+        RoomHub* owner = nullptr;
+        qint64 detachedMs = 0;      // 0 表示仍附着在某个连接上
+        quint64 chatSeq = 0;
+    };
+    QByteArray sign(quint64 id) const;
+    void expire(qint64 nowMs);
+
+    static const int kDefaultGraceMs = 30000;
+
+    mutable QMutex mutex_;
+    QHash<quint64, Session> sessions_;
+    QByteArray secret_;
+    int graceMs_ = kDefaultGraceMs;
+    qint64 nextExpireMs_ = 0;
+    QAtomicInteger<quint64> chatSeq_{0};
+};
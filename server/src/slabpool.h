@@ -0,0 +1,77 @@
+#pragma once
+// ===============================================
+// server/src/slabpool.h
+// 定长对象池：按块（slab）批量分配存储，释放的对象进入空闲链表复用
+// 交接班时大量客户端同时重连，连接记录的分配/释放不再逐个走全局 new/delete
+// 进程级共享并加锁：连接在 worker 之间迁移后，由目标 worker 释放回同一个池
+// ===============================================
+#include <QtCore>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename T, int SlabSize = 64>
+class SlabPool
+{
+public:
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+    // 块只在池析构时归还（池为进程级对象，此时不应再有存活的对象）
+    ~SlabPool() { qDeleteAll(slabs_); }
+
+    // 取一个空闲槽并在其上构造对象
+    template <typename... Args>
+    T* create(Args&&... args)
+    {
+        Slot* slot;
+        {
+            QMutexLocker lock(&mutex_);
+            if (!free_)
+                grow();
+            slot = free_;
+            free_ = slot->next;
+            ++live_;
+        }
+        return new (slot) T(std::forward<Args>(args)...);
+    }
+
+    // 析构对象并把槽放回空闲链表
+    void destroy(T* obj)
+    {
+        if (!obj) return;
+        obj->~T();
+        Slot* slot = reinterpret_cast<Slot*>(obj);
+        QMutexLocker lock(&mutex_);
+        slot->next = free_;
+        free_ = slot;
+        --live_;
+    }
+
+    int live() const { QMutexLocker lock(&mutex_); return live_; }
+    int capacity() const { QMutexLocker lock(&mutex_); return slabs_.size() * SlabSize; }
+
+private:
+    union Slot {
+        Slot* next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+    struct Slab {
+        Slot slots[SlabSize];
+    };
+
+    void grow()
+    {
+        Slab* slab = new Slab;
+        slabs_.append(slab);
+        for (int i = SlabSize - 1; i >= 0; --i) {
+            slab->slots[i].next = free_;
+            free_ = &slab->slots[i];
+        }
+    }
+
+    mutable QMutex mutex_;
+    QVector<Slab*> slabs_;
+    Slot* free_ = nullptr;
+    int live_ = 0;
+};
@@ -0,0 +1,57 @@
+#pragma once
+// ===============================================
+// server/src/spscqueue.h
+// 单生产者/单消费者无锁环形队列（容量为2的幂）
+// - 生产者只写 tail_，消费者只写 head_，两端各自读对方的下标（acquire/release 配对）
+// - 满时 push 返回 false，由调用方决定丢弃策略；从不阻塞
+// ===============================================
+#include <QtCore>
+#include <utility>
+
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(int capacityPow2)
+        : mask_(quint32(capacityPow2) - 1), slots_(capacityPow2)
+    {
+        Q_ASSERT(capacityPow2 > 0 && (capacityPow2 & (capacityPow2 - 1)) == 0);
+    }
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // 生产者线程
+    bool push(T&& item)
+    {
+        const quint32 tail = tail_.load();
+        if (tail - head_.loadAcquire() > mask_)
+            return false; // 满
+        slots_[int(tail & mask_)] = std::move(item);
+        tail_.storeRelease(tail + 1);
+        return true;
+    }
+
+    // 消费者线程；取出的槽重置为空值，及时释放其持有的数据
+    bool pop(T& out)
+    {
+        const quint32 head = head_.load();
+        if (head == tail_.loadAcquire())
+            return false; // 空
+        T& slot = slots_[int(head & mask_)];
+        out = std::move(slot);
+        slot = T();
+        head_.storeRelease(head + 1);
+        return true;
+    }
+
+    // 近似值（任一线程可读）
+    int size() const { return int(tail_.loadAcquire() - head_.loadAcquire()); }
+    int capacity() const { return int(mask_) + 1; }
+
+private:
+    const quint32 mask_;
+    QVector<T> slots_;
+    // 分开缓存行，避免两端互相使对方的缓存行失效
+    alignas(64) QAtomicInteger<quint32> head_{0};
+    alignas(64) QAtomicInteger<quint32> tail_{0};
+};
@@ -0,0 +1,607 @@
+#include "timeseries.h"
+#include <algorithm>
+#include <cstring>
+
+// ---------------- 位流 ----------------
+
+// 追加 value 的低 n 位（高位在前）
+static void writeBits(QByteArray& buf, int& nbits, quint64 value, int n)
+{
+    while (n > 0) {
+        if ((nbits & 7) == 0) buf.append('\0');
+        const int room = 8 - (nbits & 7);
+        const int take = qMin(room, n);
+        const quint64 chunk = (value >> (n - take)) & ((quint64(1) << take) - 1);
+        buf.data()[buf.size() - 1] |= char(chunk << (room - take));
+        n -= take;
+        nbits += take;
+    }
+}
+
+class BitReader
+{
+public:
+    BitReader(const QByteArray& buf) : p_(reinterpret_cast<const uchar*>(buf.constData())) {}
+    quint64 read(int n)
+    {
+        quint64 v = 0;
+        while (n > 0) {
+            const int room = 8 - (pos_ & 7);
+            const int take = qMin(room, n);
+            const quint64 chunk = (p_[pos_ >> 3] >> (room - take)) & ((1u << take) - 1);
+            v = (v << take) | chunk;
+            n -= take;
+            pos_ += take;
+        }
+        return v;
+    }
+    bool bit() { return read(1) != 0; }
+
+private:
+    const uchar* p_;
+    int pos_ = 0;
+};
+
+static quint64 doubleBits(double v)
+{
+    quint64 b;
+    memcpy(&b, &v, sizeof(b));
+    return b;
+}
+
+static double bitsDouble(quint64 b)
+{
+    double v;
+    memcpy(&v, &b, sizeof(v));
+    return v;
+}
+
+// ---------------- TsBucket ----------------
+
+void TsBucket::add(double v)
+{
+    if (count == 0) {
+        min = max = v;
+    } else {
+        min = qMin(min, v);
+        max = qMax(max, v);
+    }
+    sum += v;
+    ++count;
+}
+
+void TsBucket::merge(const TsBucket& other)
+{
+    if (other.count == 0) return;
+    if (count == 0) {
+        min = other.min;
+        max = other.max;
+    } else {
+        min = qMin(min, other.min);
+        max = qMax(max, other.max);
+    }
+    sum += other.sum;
+    count += other.count;
+}
+
+// ---------------- TsChunk ----------------
+// 时间戳列：第一个点存于块头；之后写 delta-of-delta：
+//   0 -> '0'；[-63,64] -> '10'+7位；[-255,256] -> '110'+9位；[-2047,2048] -> '1110'+12位；其他 -> '1111'+64位
+// 数值列：第一个值64位原样；之后与上一个值异或：
+//   相同 -> '0'；有效位落在上一个窗口内 -> '10'+窗口内的位；否则 -> '11'+5位前导零数+6位(有效位数-1)+有效位
+
+bool TsChunk::append(qint64 ms, double value)
+{
+    if (count_ >= kMaxSamples) return false;
+    const quint64 bits = doubleBits(value);
+    if (count_ == 0) {
+        firstMs_ = lastMs_ = ms;
+        writeBits(values_, valueBits_, bits, 64);
+        min_ = max_ = sum_ = value;
+        lastValue_ = bits;
+        ++count_;
+        return true;
+    }
+
+    const qint64 delta = ms - lastMs_;
+    const qint64 dod = delta - lastDelta_;
+    if (dod == 0) {
+        writeBits(times_, timeBits_, 0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        writeBits(times_, timeBits_, 0x2, 2);
+        writeBits(times_, timeBits_, quint64(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        writeBits(times_, timeBits_, 0x6, 3);
+        writeBits(times_, timeBits_, quint64(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        writeBits(times_, timeBits_, 0xE, 4);
+        writeBits(times_, timeBits_, quint64(dod + 2047), 12);
+    } else {
+        writeBits(times_, timeBits_, 0xF, 4);
+        writeBits(times_, timeBits_, quint64(dod), 64);
+    }
+    lastDelta_ = delta;
+    lastMs_ = ms;
+
+    const quint64 x = bits ^ lastValue_;
+    if (x == 0) {
+        writeBits(values_, valueBits_, 0, 1);
+    } else {
+        const int lead = qMin(int(qCountLeadingZeroBits(x)), 31);
+        const int trail = int(qCountTrailingZeroBits(x));
+        if (leading_ >= 0 && lead >= leading_ && trail >= trailing_) {
+            writeBits(values_, valueBits_, 0x2, 2);
+            writeBits(values_, valueBits_, x >> trailing_, 64 - leading_ - trailing_);
+        } else {
+            const int sig = 64 - lead - trail;
+            writeBits(values_, valueBits_, 0x3, 2);
+            writeBits(values_, valueBits_, quint64(lead), 5);
+            writeBits(values_, valueBits_, quint64(sig - 1), 6);
+            writeBits(values_, valueBits_, x >> trail, sig);
+            leading_ = lead;
+            trailing_ = trail;
+        }
+    }
+    lastValue_ = bits;
+
+    min_ = qMin(min_, value);
+    max_ = qMax(max_, value);
+    sum_ += value;
+    ++count_;
+    return true;
+}
+
+void TsChunk::decode(QVector<TsPoint>& out, qint64 fromMs, qint64 toMs) const
+{
+    if (count_ == 0 || lastMs_ < fromMs || firstMs_ > toMs) return;
+    BitReader times(times_);
+    BitReader values(values_);
+    qint64 ms = firstMs_;
+    qint64 delta = 0;
+    quint64 bits = values.read(64);
+    int leading = 0, trailing = 0;
+    for (int i = 0; i < count_; ++i) {
+        if (i > 0) {
+            qint64 dod;
+            if (!times.bit()) dod = 0;
+            else if (!times.bit()) dod = qint64(times.read(7)) - 63;
+            else if (!times.bit()) dod = qint64(times.read(9)) - 255;
+            else if (!times.bit()) dod = qint64(times.read(12)) - 2047;
+            else dod = qint64(times.read(64));
+            delta += dod;
+            ms += delta;
+
+            if (values.bit()) {
+                if (values.bit()) {
+                    leading = int(values.read(5));
+                    const int sig = int(values.read(6)) + 1;
+                    trailing = 64 - leading - sig;
+                }
+                bits ^= values.read(64 - leading - trailing) << trailing;
+            }
+        }
+        if (ms > toMs) break;
+        if (ms >= fromMs) {
+            TsPoint pt;
+            pt.ms = ms;
+            pt.value = bitsDouble(bits);
+            out.append(pt);
+        }
+    }
+}
+
+TsBucket TsChunk::summary() const
+{
+    TsBucket b;
+    b.startMs = firstMs_;
+    b.min = min_;
+    b.max = max_;
+    b.sum = sum_;
+    b.count = quint32(count_);
+    return b;
+}
+
+// ---------------- TimeSeriesStore ----------------
+
+TimeSeriesStore& TimeSeriesStore::instance()
+{
+    static TimeSeriesStore store;
+    return store;
+}
+
+TimeSeriesStore::~TimeSeriesStore()
+{
+    for (Shard& shard : shards_)
+        qDeleteAll(shard.series);
+}
+
+qint64 TimeSeriesStore::resolutionMs(Resolution r)
+{
+    static const qint64 kWidth[ResolutionCount] = { 1000, 60 * 1000, 3600 * 1000 };
+    return kWidth[r];
+}
+
+QString TimeSeriesStore::seriesKey(const QString& ticket, const QString& device, const QString& metric)
+{
+    return ticket + QChar(0x1f) + device + QChar(0x1f) + metric;
+}
+
+TimeSeriesStore::Shard& TimeSeriesStore::shardFor(const QString& key) const
+{
+    return shards_[qHash(key) % kShards];
+}
+
+void TimeSeriesStore::addToRollup(QVector<TsBucket>& buckets, qint64 width, qint64 ms, double value)
+{
+    const qint64 start = ms - ms % width;
+    if (buckets.isEmpty() || buckets.last().startMs < start) {
+        TsBucket b;
+        b.startMs = start;
+        b.add(value);
+        buckets.append(b);
+    } else if (buckets.last().startMs == start) {
+        buckets.last().add(value);
+    }
+}
+
+bool TimeSeriesStore::append(const QString& ticket, const QString& device, const QString& metric,
+                             qint64 ms, double value)
+{
+    const QString key = seriesKey(ticket, device, metric);
+    Shard& shard = shardFor(key);
+    advanceClock(ms);
+    QMutexLocker lock(&shard.mutex);
+    Series* s = shard.series.value(key);
+    if (!s) {
+        if (seriesCount_.load() >= kMaxSeries) {
+            // 序列数到上限：淘汰空闲序列后重试（sweep 逐个加各分片的锁，先放开本分片）
+            lock.unlock();
+            sweep(true);
+            lock.relock();
+            s = shard.series.value(key); // 放锁期间可能已被其他线程创建
+        }
+        if (!s) {
+            if (seriesCount_.load() >= kMaxSeries) return false;
+            s = new Series;
+            shard.series.insert(key, s);
+            seriesCount_.ref();
+        }
+    }
+
+    ms = qMax(ms, s->lastMs);
+    s->lastMs = ms;
+    if (s->chunks.isEmpty() || !s->chunks.last().append(ms, value)) {
+        // 块写满：淘汰过期数据后开新块
+        expire(*s, ms);
+        s->chunks.append(TsChunk());
+        s->chunks.last().append(ms, value);
+    }
+    for (int r = 0; r < ResolutionCount; ++r)
+        addToRollup(s->rollups[r], resolutionMs(Resolution(r)), ms, value);
+    return true;
+}
+
+// 推进全局时钟；每过 kSweepIntervalMs 由推进时钟的线程执行一次 sweep（不持有任何分片锁时调用）
+void TimeSeriesStore::advanceClock(qint64 ms)
+{
+    qint64 latest = latestMs_.load();
+    while (ms > latest && !latestMs_.testAndSetOrdered(latest, ms))
+        latest = latestMs_.load();
+    const qint64 next = nextSweepMs_.load();
+    if (ms >= next && nextSweepMs_.testAndSetOrdered(next, ms + kSweepIntervalMs))
+        sweep(false);
+}
+
+void TimeSeriesStore::sweep(bool evictIdle)
+{
+    QMutexLocker sweeping(&sweepMutex_);
+    const qint64 nowMs = latestMs_.load();
+
+    // 空闲候选：原始数据已全部过期的序列，(最后写入时间, 分片, key)
+    struct Idle {
+        qint64 lastMs;
+        int shard;
+        QString key;
+        bool operator<(const Idle& o) const { return lastMs < o.lastMs; }
+    };
+    QVector<Idle> idle;
+    for (int i = 0; i < kShards; ++i) {
+        Shard& shard = shards_[i];
+        QMutexLocker lock(&shard.mutex);
+        for (auto it = shard.series.begin(); it != shard.series.end();) {
+            Series* s = it.value();
+            expire(*s, nowMs);
+            bool empty = s->chunks.isEmpty();
+            for (const QVector<TsBucket>& b : s->rollups)
+                empty = empty && b.isEmpty();
+            if (empty) {
+                delete s;
+                it = shard.series.erase(it);
+                seriesCount_.deref();
+                continue;
+            }
+            if (evictIdle && s->chunks.isEmpty())
+                idle.append(Idle{s->lastMs, i, it.key()});
+            ++it;
+        }
+    }
+
+    const int excess = seriesCount_.load() - (kMaxSeries - kSweepHeadroom);
+    if (!evictIdle || excess <= 0 || idle.isEmpty()) return;
+    std::sort(idle.begin(), idle.end());
+    int removed = 0;
+    for (const Idle& c : idle) {
+        if (removed >= excess) break;
+        Shard& shard = shards_[c.shard];
+        QMutexLocker lock(&shard.mutex);
+        auto it = shard.series.find(c.key);
+        // 两次加锁之间有新数据写入的序列保留
+        if (it == shard.series.end() || !it.value()->chunks.isEmpty()) continue;
+        delete it.value();
+        shard.series.erase(it);
+        seriesCount_.deref();
+        ++removed;
+    }
+    evicted_.fetchAndAddRelaxed(quint64(removed));
+}
+
+void TimeSeriesStore::expire(Series& s, qint64 nowMs) const
+{
+    int drop = 0;
+    while (drop < s.chunks.size() && s.chunks.at(drop).lastMs() < nowMs - rawRetentionMs_)
+        ++drop;
+    if (drop > 0)
+        s.rawExpiredMs = s.chunks.at(drop - 1).lastMs();
+    s.chunks.remove(0, drop);
+
+    const qint64 retention[ResolutionCount] = { qMin(rawRetentionMs_, qint64(kSecondRetentionMs)),
+                                                kMinuteRetentionMs, kHourRetentionMs };
+    for (int r = 0; r < ResolutionCount; ++r) {
+        QVector<TsBucket>& b = s.rollups[r];
+        const qint64 oldest = nowMs - retention[r];
+        auto it = std::lower_bound(b.begin(), b.end(), oldest,
+                                   [](const TsBucket& x, qint64 t) { return x.startMs < t; });
+        if (it != b.begin())
+            s.rollupExpiredMs[r] = (it - 1)->startMs + resolutionMs(Resolution(r)) - 1;
+        b.remove(0, int(it - b.begin()));
+    }
+}
+
+void TimeSeriesStore::rawOf(const Series& s, qint64 fromMs, qint64 toMs, QVector<TsPoint>& out)
+{
+    // 第一个 lastMs >= fromMs 的块
+    auto it = std::lower_bound(s.chunks.constBegin(), s.chunks.constEnd(), fromMs,
+                               [](const TsChunk& c, qint64 t) { return c.lastMs() < t; });
+    for (; it != s.chunks.constEnd() && it->firstMs() <= toMs; ++it)
+        it->decode(out, fromMs, toMs);
+}
+
+QVector<TsBucket> TimeSeriesStore::rollupOf(const Series& s, Resolution r, qint64 fromMs, qint64 toMs)
+{
+    const QVector<TsBucket>& b = s.rollups[r];
+    // 与 [fromMs, toMs] 相交的桶：startMs > fromMs - 宽度，且 startMs <= toMs
+    const qint64 width = resolutionMs(r);
+    auto first = std::upper_bound(b.constBegin(), b.constEnd(), fromMs - width,
+                                  [](qint64 t, const TsBucket& x) { return t < x.startMs; });
+    auto last = std::upper_bound(first, b.constEnd(), toMs,
+                                 [](qint64 t, const TsBucket& x) { return t < x.startMs; });
+    return b.mid(int(first - b.constBegin()), int(last - first));
+}
+
+TsBucket TimeSeriesStore::aggregateOf(const Series& s, qint64 fromMs, qint64 toMs)
+{
+    TsBucket total;
+    total.startMs = fromMs;
+    if (fromMs > s.rawExpiredMs) {
+        // 原始数据覆盖整个范围：完整落在范围内的块直接取块头
+        auto it = std::lower_bound(s.chunks.constBegin(), s.chunks.constEnd(), fromMs,
+                                   [](const TsChunk& c, qint64 t) { return c.lastMs() < t; });
+        QVector<TsPoint> edge;
+        for (; it != s.chunks.constEnd() && it->firstMs() <= toMs; ++it) {
+            if (it->firstMs() >= fromMs && it->lastMs() <= toMs) {
+                total.merge(it->summary());
+                continue;
+            }
+            edge.clear();
+            it->decode(edge, fromMs, toMs);
+            for (const TsPoint& pt : edge) total.add(pt.value);
+        }
+        return total;
+    }
+
+    // 更早的范围：用覆盖范围起点的最细一级汇总（边缘按整桶计入）
+    Resolution r = Hour;
+    for (int i = Second; i < ResolutionCount; ++i) {
+        if (fromMs > s.rollupExpiredMs[i]) {
+            r = Resolution(i);
+            break;
+        }
+    }
+    for (const TsBucket& b : rollupOf(s, r, fromMs, toMs))
+        total.merge(b);
+    return total;
+}
+
+QVector<TsPoint> TimeSeriesStore::raw(const QString& ticket, const QString& device, const QString& metric,
+                                      qint64 fromMs, qint64 toMs) const
+{
+    QVector<TsPoint> out;
+    const QString key = seriesKey(ticket, device, metric);
+    Shard& shard = shardFor(key);
+    QMutexLocker lock(&shard.mutex);
+    if (const Series* s = shard.series.value(key))
+        rawOf(*s, fromMs, toMs, out);
+    return out;
+}
+
+QVector<TsBucket> TimeSeriesStore::rollup(const QString& ticket, const QString& device, const QString& metric,
+                                          Resolution resolution, qint64 fromMs, qint64 toMs) const
+{
+    const QString key = seriesKey(ticket, device, metric);
+    Shard& shard = shardFor(key);
+    QMutexLocker lock(&shard.mutex);
+    const Series* s = shard.series.value(key);
+    return s ? rollupOf(*s, resolution, fromMs, toMs) : QVector<TsBucket>();
+}
+
+TsBucket TimeSeriesStore::aggregate(const QString& ticket, const QString& device, const QString& metric,
+                                    qint64 fromMs, qint64 toMs) const
+{
+    const QString key = seriesKey(ticket, device, metric);
+    Shard& shard = shardFor(key);
+    QMutexLocker lock(&shard.mutex);
+    const Series* s = shard.series.value(key);
+    if (!s) {
+        TsBucket empty;
+        empty.startMs = fromMs;
+        return empty;
+    }
+    return aggregateOf(*s, fromMs, toMs);
+}
+
+TsQueryResult TimeSeriesStore::query(const QString& ticket, const QString& device, const QString& metric,
+                                     qint64 fromMs, qint64 toMs, int maxPoints) const
+{
+    static const char* const kRollupName[ResolutionCount] = { "1s", "1m", "1h" };
+    TsQueryResult result;
+    const int n = qBound(3, maxPoints, int(kMaxQueryPoints));
+    const QString key = seriesKey(ticket, device, metric);
+    Shard& shard = shardFor(key);
+    // 需要原始点时只在锁内复制相交的块（列数据隐式共享），解压与 LTTB 在锁外进行，不阻塞同分片的写入
+    QVector<TsChunk> chunks;
+    {
+        QMutexLocker lock(&shard.mutex);
+        const Series* s = shard.series.value(key);
+        if (!s || toMs < fromMs) return result;
+        const qint64 span = toMs - fromMs;
+
+        // 点数只看块头（边缘两块才解压）
+        const bool rawCovers = fromMs > s->rawExpiredMs;
+        const quint32 count = rawCovers ? aggregateOf(*s, fromMs, toMs).count : 0;
+        if (!rawCovers || count > quint32(n)) {
+            // 点数太多：覆盖整个范围的最细一级汇总（都不完整时用1小时汇总）
+            Resolution r = Hour;
+            for (int i = Second; i < ResolutionCount; ++i) {
+                if (fromMs > s->rollupExpiredMs[i]) {
+                    r = Resolution(i);
+                    break;
+                }
+            }
+            // 该级桶数不少于 n 时合并到 n 个以内；桶数远少于 n 而原始点数有限时，改对原始数据做 LTTB，
+            // 结果接近 n 个点（如默认的最近1小时/1000点：1秒汇总已过期，1分钟汇总只有61个桶）
+            if (span / resolutionMs(r) + 1 >= n || !rawCovers || count > kMaxRawDecode) {
+                result.buckets = rollupOf(*s, r, fromMs, toMs);
+                result.scanned = quint64(result.buckets.size());
+                result.buckets = mergeBuckets(result.buckets, n);
+                result.source = kRollupName[r];
+                return result;
+            }
+        }
+        auto first = std::lower_bound(s->chunks.constBegin(), s->chunks.constEnd(), fromMs,
+                                      [](const TsChunk& c, qint64 t) { return c.lastMs() < t; });
+        auto last = first;
+        while (last != s->chunks.constEnd() && last->firstMs() <= toMs) ++last;
+        chunks = s->chunks.mid(int(first - s->chunks.constBegin()), int(last - first));
+    }
+
+    for (const TsChunk& c : chunks)
+        c.decode(result.points, fromMs, toMs);
+    result.scanned = quint64(result.points.size());
+    if (result.points.size() > n) {
+        result.points = downsampleLttb(result.points, n);
+        result.source = "lttb";
+    } else {
+        result.source = "raw";
+    }
+    return result;
+}
+
+QVector<TsPoint> TimeSeriesStore::downsampleLttb(const QVector<TsPoint>& points, int n)
+{
+    const int size = points.size();
+    if (n >= size || n < 3) return points;
+
+    QVector<TsPoint> out;
+    out.reserve(n);
+    out.append(points.first());
+    // 除首尾外分成 n-2 个桶；每个桶选与“上一个选中点、下一个桶的平均点”构成三角形面积最大的点
+    const double every = double(size - 2) / (n - 2);
+    int a = 0;
+    for (int i = 0; i < n - 2; ++i) {
+        const int avgStart = int(i * every + every) + 1;
+        const int avgEnd = qMin(int(i * every + 2 * every) + 1, size);
+        double avgX = 0, avgY = 0;
+        for (int j = avgStart; j < avgEnd; ++j) {
+            avgX += double(points.at(j).ms);
+            avgY += points.at(j).value;
+        }
+        const int avgCount = qMax(1, avgEnd - avgStart);
+        avgX /= avgCount;
+        avgY /= avgCount;
+        if (avgEnd <= avgStart) {
+            avgX = double(points.last().ms);
+            avgY = points.last().value;
+        }
+
+        const int start = int(i * every) + 1;
+        const int end = qMin(int(i * every + every) + 1, size - 1);
+        const double ax = double(points.at(a).ms);
+        const double ay = points.at(a).value;
+        double best = -1;
+        int pick = start;
+        for (int j = start; j < end; ++j) {
+            const double area = qAbs((ax - avgX) * (points.at(j).value - ay)
+                                     - (ax - double(points.at(j).ms)) * (avgY - ay));
+            if (area > best) {
+                best = area;
+                pick = j;
+            }
+        }
+        out.append(points.at(pick));
+        a = pick;
+    }
+    out.append(points.last());
+    return out;
+}
+
+QVector<TsBucket> TimeSeriesStore::mergeBuckets(const QVector<TsBucket>& buckets, int n)
+{
+    if (buckets.size() <= n || n <= 0) return buckets;
+    const int group = (buckets.size() + n - 1) / n;
+    QVector<TsBucket> out;
+    out.reserve(n);
+    for (int i = 0; i < buckets.size(); i += group) {
+        TsBucket b;
+        b.startMs = buckets.at(i).startMs;
+        for (int j = i; j < qMin(i + group, buckets.size()); ++j)
+            b.merge(buckets.at(j));
+        out.append(b);
+    }
+    return out;
+}
+
+QJsonObject TimeSeriesStore::stats() const
+{
+    int series = 0;
+    qint64 points = 0, bytes = 0, buckets = 0;
+    for (const Shard& shard : shards_) {
+        QMutexLocker lock(&shard.mutex);
+        for (const Series* s : shard.series) {
+            ++series;
+            for (const TsChunk& c : s->chunks) {
+                points += c.count();
+                bytes += c.bytes();
+            }
+            for (const QVector<TsBucket>& b : s->rollups)
+                buckets += b.size();
+        }
+    }
+    return QJsonObject{
+        {"series", series},
+        {"evictedSeries", double(evicted_.load())},
+        {"points", double(points)},
+        {"compressedBytes", double(bytes)},
+        {"bytesPerPoint", points ? double(bytes) / points : 0.0},
+        {"rollupBuckets", double(buckets)}
+    };
+}
@@ -0,0 +1,168 @@
+#pragma once
+// ===============================================
+// server/src/timeseries.h
+// 设备数据时序库（进程内）：按 工单/设备/指标 分序列保存 MSG_DEVICE_DATA 的数值
+// - 原始数据为列式压缩块：时间戳列 delta-of-delta、数值列 XOR（Gorilla 编码），
+//   每块最多 TsChunk::kMaxSamples 个点；块头记录时间范围与 min/max/sum，范围聚合只解压边缘的块
+// - 写入时同步维护 1秒 / 1分钟 / 1小时 三级汇总（min/max/avg/count），长时间范围的查询直接读汇总
+// - 汇总桶只在有数据的时间段存在；各级数据按保留期淘汰，序列数有上限，内存有界
+// - 单个序列的内存上限：原始数据每点约1~2字节（最坏约18字节）× 保留期内的点数；
+//   汇总桶每个40字节，1秒汇总保留15分钟（≤900桶，约36KB），1分钟汇总保留7天（≤10080桶，约400KB），
+//   1小时汇总保留400天（≤9600桶，约380KB）
+// - 进程级共享：序列按键散列到若干分片，每个分片一把锁，多个 worker 同时写入互不阻塞
+// ===============================================
+#include <QtCore>
+
+struct TsPoint {
+    qint64 ms = 0;
+    double value = 0;
+};
+
+// 汇总桶：[startMs, startMs + 分辨率)
+struct TsBucket {
+    qint64 startMs = 0;
+    double min = 0;
+    double max = 0;
+    double sum = 0;
+    quint32 count = 0;
+
+    double avg() const { return count ? sum / count : 0; }
+    void add(double v);
+    void merge(const TsBucket& other);
+};
+
+// 一个压缩块（只追加）
+class TsChunk
+{
+public:
+    static const int kMaxSamples = 1024;
+
+    // 时间戳需单调不减；块满时返回 false
+    bool append(qint64 ms, double value);
+    void decode(QVector<TsPoint>& out, qint64 fromMs, qint64 toMs) const;
+
+    int count() const { return count_; }
+    qint64 firstMs() const { return firstMs_; }
+    qint64 lastMs() const { return lastMs_; }
+    // 块内全部点的聚合（块头，不需解压）
+    TsBucket summary() const;
+    int bytes() const { return times_.size() + values_.size(); }
+
+private:
+    QByteArray times_;          // 时间戳列（位流）
+    QByteArray values_;         // 数值列（位流）
+    int timeBits_ = 0;
+    int valueBits_ = 0;
+    int count_ = 0;
+    qint64 firstMs_ = 0;
+    qint64 lastMs_ = 0;
+    qint64 lastDelta_ = 0;
+    quint64 lastValue_ = 0;     // 上一个值的位模式
+    int leading_ = -1;          // 上一个 XOR 有效位窗口
+    int trailing_ = 0;
+    double min_ = 0;
+    double max_ = 0;
+    double sum_ = 0;
+};
+
+// 降采样查询的结果：原始点（raw/lttb）或汇总桶（1s/1m/1h）二者之一
+struct TsQueryResult {
+    QString source;              // "raw" | "lttb" | "1s" | "1m" | "1h"；序列不存在时为空
+    QVector<TsPoint> points;
+    QVector<TsBucket> buckets;
+    quint64 scanned = 0;         // 参与计算的原始点数或汇总桶数
+};
+
+class TimeSeriesStore
+{
+public:
+    enum Resolution { Second = 0, Minute = 1, Hour = 2, ResolutionCount = 3 };
+
+    static TimeSeriesStore& instance();
+
+    // 原始数据的保留时长（默认6小时）；1秒汇总保留 kSecondRetentionMs（不超过原始数据），
+    // 1分钟汇总保留7天，1小时汇总保留400天
+    void setRawRetention(qint64 ms) { rawRetentionMs_ = ms; }
+
+    // 写入一个点：同一序列的时间戳小于上一个点时按上一个点的时间记（保持单调）
+    // 序列数达到上限时先淘汰空闲的序列（见 sweep），仍无空位时新序列被丢弃，返回 false
+    bool append(const QString& ticket, const QString& device, const QString& metric,
+                qint64 ms, double value);
+
+    // [fromMs, toMs] 内的原始点：只解压与范围相交的块
+    QVector<TsPoint> raw(const QString& ticket, const QString& device, const QString& metric,
+                         qint64 fromMs, qint64 toMs) const;
+    // [fromMs, toMs] 内某一级汇总的桶（二分定位，不解压原始数据）
+    QVector<TsBucket> rollup(const QString& ticket, const QString& device, const QString& metric,
+                             Resolution resolution, qint64 fromMs, qint64 toMs) const;
+    // 整个范围的聚合：完整覆盖的块用块头，边缘的块才解压
+    TsBucket aggregate(const QString& ticket, const QString& device, const QString& metric,
+                       qint64 fromMs, qint64 toMs) const;
+
+    // 图表查询：返回不超过 maxPoints 个点/桶，尽量接近 maxPoints
+    // - 范围内有原始数据且点数不超过 maxPoints：原始点
+    // - 否则取覆盖整个范围的最细一级汇总，桶数超过 maxPoints 时合并相邻的桶
+    // - 该级桶数不到 maxPoints 而原始数据覆盖范围、点数不超过 kMaxRawDecode 时：原始点 LTTB 降采样
+    // 每个桶保留 min/max，降采样不会抹掉尖峰
+    TsQueryResult query(const QString& ticket, const QString& device, const QString& metric,
+                        qint64 fromMs, qint64 toMs, int maxPoints) const;
+
+    // Largest-Triangle-Three-Buckets：保留形状（含极值）的降采样，n >= 3
+    static QVector<TsPoint> downsampleLttb(const QVector<TsPoint>& points, int n);
+    // 把相邻的桶合并到不超过 n 个
+    static QVector<TsBucket> mergeBuckets(const QVector<TsBucket>& buckets, int n);
+
+    static qint64 resolutionMs(Resolution r);
+
+    // 按全局最新时间淘汰所有序列的过期数据，删除已完全过期的序列（append 每分钟自动执行一次）
+    // evictIdle：序列数接近上限时，按最后写入时间从早到晚删除原始数据已全部过期的序列，留出 kSweepHeadroom 个空位
+    void sweep(bool evictIdle = false);
+
+    // 序列数、点数、压缩后字节数等
+    QJsonObject stats() const;
+
+    static const int kMaxSeries = 20000;
+    static const int kSweepHeadroom = kMaxSeries / 10;
+    static const qint64 kSweepIntervalMs = 60 * 1000;
+    static const int kMaxQueryPoints = 10000;
+    static const quint32 kMaxRawDecode = 64 * 1024; // 查询时最多解压的原始点数（约1毫秒），更多时改用汇总
+    static const qint64 kSecondRetentionMs = 15 * 60 * 1000; // 1秒汇总未压缩，只保留最近一段
+    static const qint64 kMinuteRetentionMs = 7LL * 24 * 3600 * 1000;
+    static const qint64 kHourRetentionMs = 400LL * 24 * 3600 * 1000;
+
+private:
+    TimeSeriesStore() = default;
+    ~TimeSeriesStore();
+
+    struct Series {
+        QVector<TsChunk> chunks;   // 按时间排序，最后一个为正在写入的块
+        QVector<TsBucket> rollups[ResolutionCount];
+        qint64 lastMs = 0;
+        // 已淘汰数据的截止时间：早于等于此时间的范围在该级别上不完整
+        qint64 rawExpiredMs = 0;
+        qint64 rollupExpiredMs[ResolutionCount] = {0, 0, 0};
+    };
+    static const int kShards = 16;
+    struct Shard {
+        mutable QMutex mutex;
+        QHash<QString, Series*> series;
+    };
+
+    static QString seriesKey(const QString& ticket, const QString& device, const QString& metric);
+    Shard& shardFor(const QString& key) const;
+    void expire(Series& s, qint64 nowMs) const;
+    static void rawOf(const Series& s, qint64 fromMs, qint64 toMs, QVector<TsPoint>& out);
+    static QVector<TsBucket> rollupOf(const Series& s, Resolution r, qint64 fromMs, qint64 toMs);
+    static TsBucket aggregateOf(const Series& s, qint64 fromMs, qint64 toMs);
+    static void addToRollup(QVector<TsBucket>& buckets, qint64 width, qint64 ms, double value);
+    void advanceClock(qint64 ms);
+
+    mutable Shard shards_[kShards];
+    QAtomicInt seriesCount_{0};
+    QAtomicInteger<quint64> evicted_{0};
+    // 全局时钟：所有序列写入过的最新时间（服务器收到时间），过期判断都以它为准，与挂钟无关
+    QAtomicInteger<qint64> latestMs_{0};
+    QAtomicInteger<qint64> nextSweepMs_{0};
+    QMutex sweepMutex_;
+    qint64 rawRetentionMs_ = 6LL * 3600 * 1000;
+};
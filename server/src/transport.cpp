@@ -0,0 +1,14 @@
+#include "transport.h"
+#include "qttransport.h"
+#include "epolltransport.h"
+
+Transport* Transport::create(const QString& name, QObject* parent)
+{
+    if (name.isEmpty() || name == QLatin1String("qt"))
+        return new QtTransport(parent);
+#ifdef Q_OS_LINUX
+    if (name == QLatin1String("epoll"))
+        return new EpollTransport(parent);
+#endif
+    return nullptr;
+}
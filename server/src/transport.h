@@ -0,0 +1,58 @@
+#pragma once
+// ===============================================
+// server/src/transport.h
+// 传输层抽象：RoomHub 只通过 Transport/Connection 接受连接、收发字节
+// - qt（默认）：QTcpServer/QTcpSocket，见 qttransport.h
+// - epoll（仅Linux）：边沿触发epoll + 池化接收块 + sendmsg/writev，见 epolltransport.h
+// 每个 Transport 属于一个线程（一个 RoomHub）；连接迁移到其他worker时，
+// 源线程 release()，目标线程 adopt()
+// ===============================================
+#include <QtCore>
+#include <QtNetwork>
+
+class Connection : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Connection(QObject* parent = nullptr) : QObject(parent) {}
+
+    // 读出当前已到达的数据（可能只是一部分，剩余数据会再次触发 readyRead）
+    virtual QByteArray read() = 0;
+    virtual qint64 bytesAvailable() const = 0;
+    // 已接受、尚未交给内核的字节数（发送队列据此判断拥塞）
+    virtual qint64 bytesToWrite() const = 0;
+    // 按顺序写出若干段；内核放不下的部分由连接自己缓冲。出错返回 -1
+    virtual qint64 writeSegments(const QByteArray* segs, int count) = 0;
+    virtual bool isConnected() const = 0;
+    virtual QHostAddress peerAddress() const = 0;
+    virtual quint16 peerPort() const = 0;
+    virtual void setSendBufferSize(int bytes) = 0;
+
+signals:
+    void readyRead();
+    void bytesWritten(qint64 bytes);
+    void disconnected();
+};
+
+class Transport : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Transport(QObject* parent = nullptr) : QObject(parent) {}
+
+    // name: "qt" 或 "epoll"；不支持时返回 nullptr
+    static Transport* create(const QString& name, QObject* parent = nullptr);
+
+    virtual QString name() const = 0;
+    virtual bool listen(const QHostAddress& address, quint16 port) = 0;
+    virtual QHostAddress serverAddress() const = 0;
+    virtual QString errorString() const = 0;
+    // 接管 accept 得到的描述符（多worker模式由 HubServer 分配），失败返回 nullptr
+    virtual Connection* adoptDescriptor(qintptr socketDescriptor) = 0;
+    // 连接迁移：在源线程解除登记并移到 target 线程；目标线程随后调用 adopt()
+    virtual void release(Connection* conn, QThread* target) = 0;
+    virtual void adopt(Connection* conn) = 0;
+
+signals:
+    void newConnection(Connection* conn);
+};
@@ -0,0 +1,79 @@
+#include "usercache.h"
+
+UserCache::UserCache(int capacity)
+{
+    cache_.setMaxCost(capacity);
+}
+
+void UserCache::setCapacity(int capacity)
+{
+    QMutexLocker lock(&mutex_);
+    cache_.setMaxCost(qMax(0, capacity));
+}
+
+int UserCache::capacity() const
+{
+    QMutexLocker lock(&mutex_);
+    return cache_.maxCost();
+}
+
+int UserCache::size() const
+{
+    QMutexLocker lock(&mutex_);
+    return cache_.size();
+}
+
+bool UserCache::lookup(const QString& username, UserRecord* out)
+{
+    QMutexLocker lock(&mutex_);
+    const UserRecord* record = cache_.object(username); // 命中的记录移到最近使用
+    if (!record) {
+        ++misses_;
+        return false;
+    }
+    ++hits_;
+    if (out) *out = *record;
+    return true;
+}
+
+void UserCache::insert(const QString& username, const UserRecord& record)
+{
+    QMutexLocker lock(&mutex_);
+    if (cache_.maxCost() > 0)
+        cache_.insert(username, new UserRecord(record), 1);
+}
+
+void UserCache::invalidate(const QString& username)
+{
+    QMutexLocker lock(&mutex_);
+    cache_.remove(username);
+}
+
+void UserCache::clear()
+{
+    QMutexLocker lock(&mutex_);
+    cache_.clear();
+}
+
+quint64 UserCache::hits() const
+{
+    QMutexLocker lock(&mutex_);
+    return hits_;
+}
+
+quint64 UserCache::misses() const
+{
+    QMutexLocker lock(&mutex_);
+    return misses_;
+}
+
+QJsonObject UserCache::stats() const
+{
+    QMutexLocker lock(&mutex_);
+    return QJsonObject{
+        {"hits", double(hits_)},
+        {"misses", double(misses_)},
+        {"size", cache_.size()},
+        {"capacity", cache_.maxCost()}
+    };
+}
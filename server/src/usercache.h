@@ -0,0 +1,42 @@
+#pragma once
+// ===============================================
+// server/src/usercache.h
+// 用户记录缓存（LRU，容量有限）：登录校验先查这里，命中时不访问 SQLite
+// 写用户表时按用户名失效；线程安全（DB 线程与其他连接线程都可能访问）
+// ===============================================
+#include <QtCore>
+
+struct UserRecord
+{
+    int id = 0;
+    int userType = 0;
+    QString passwordHash;
+};
+
+class UserCache
+{
+public:
+    explicit UserCache(int capacity = 4096);
+
+    // 容量为 0 时关闭缓存
+    void setCapacity(int capacity);
+    int capacity() const;
+    int size() const;
+
+    // 命中时写入 out 并计为 hit，否则计为 miss
+    bool lookup(const QString& username, UserRecord* out);
+    void insert(const QString& username, const UserRecord& record);
+    void invalidate(const QString& username);
+    void clear();
+
+    quint64 hits() const;
+    quint64 misses() const;
+    // {"hits","misses","size","capacity"}
+    QJsonObject stats() const;
+
+private:
+    mutable QMutex mutex_;
+    QCache<QString, UserRecord> cache_; // 每条记录成本为 1，超出容量时淘汰最久未用的
+    quint64 hits_ = 0;
+    quint64 misses_ = 0;
+};